@@ -264,6 +264,20 @@ static inline int snd_open_device(const char *filename, int fmode)
 	snd1_config_check_hop
 #define snd_config_search_alias_hooks \
 	snd1_config_search_alias_hooks
+#define snd_input_read \
+	snd1_input_read
+#define snd_tlv_db_new \
+	snd1_tlv_db_new
+#define snd_tlv_db_free \
+	snd1_tlv_db_free
+#define snd_tlv_db_get_range \
+	snd1_tlv_db_get_range
+#define snd_tlv_db_to_dB \
+	snd1_tlv_db_to_dB
+#define snd_tlv_db_from_dB \
+	snd1_tlv_db_from_dB
+#define snd_card_cache_generation \
+	snd1_card_cache_generation
 
 /* dlobj cache */
 void *snd_dlobj_cache_lookup(const char *name);
@@ -279,4 +293,20 @@ int snd_config_search_alias_hooks(snd_config_t *config,
                                   const char *base, const char *key,
 				  snd_config_t **result);
 
+/* block reads for the configuration parser */
+ssize_t snd_input_read(snd_input_t *input, void *buf, size_t size);
+
+/* dB TLV prepared for repeated conversions */
+struct snd_tlv_db;
+int snd_tlv_db_new(struct snd_tlv_db **dbp, unsigned int *tlv,
+		   long rangemin, long rangemax);
+void snd_tlv_db_free(struct snd_tlv_db *db);
+int snd_tlv_db_get_range(const struct snd_tlv_db *db, long *min, long *max);
+int snd_tlv_db_to_dB(const struct snd_tlv_db *db, long volume, long *db_gain);
+int snd_tlv_db_from_dB(const struct snd_tlv_db *db, long db_gain, long *value,
+		       int xdir);
+
+/* card list cache, the generation changes with the devices */
+int snd_card_cache_generation(unsigned int *generation);
+
 #endif
@@ -418,7 +418,13 @@ beginning:</P>
 #include <limits.h>
 #include <sys/stat.h>
 #include <locale.h>
+#include <sys/mman.h>
 #include "local.h"
+#include <sched.h>
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#endif
 #ifdef HAVE_LIBPTHREAD
 #include <pthread.h>
 #endif
@@ -437,18 +443,89 @@ struct _snd_config {
 		struct {
 			struct list_head fields;
 			int join;
+			unsigned int count;	/* number of children */
+			unsigned int buckets;	/* size of index, power of two */
+			snd_config_t **index;	/* children by id, NULL for small compounds */
+			struct snd_config_lazy *lazy;	/* pending card loads */
 		} compound;
 	} u;
 	struct list_head list;
 	snd_config_t *parent;
+	snd_config_t *hash_next;	/* next node in the bucket of parent's index */
+	struct snd_config_arena *arena;	/* allocator of the node, NULL for malloc */
+	unsigned int flags;
 	int hop;
+	int refcount;		/* references besides the owner, see snd_config_ref() */
+};
+
+#define SND_CONFIG_ARENA_ID	(1U << 0)	/* id is allocated from the arena */
+#define SND_CONFIG_ARENA_STRING	(1U << 1)	/* string is allocated from the arena */
+#define SND_CONFIG_SHARED	(1U << 2)	/* compound of a published tree */
+#define SND_CONFIG_SETTLED	(1U << 3)	/* shared, searches do not modify it */
+#define SND_CONFIG_LOADING	(1U << 4)	/* shared, hooks or a card load running */
+#define SND_CONFIG_SHARE_MASK	(SND_CONFIG_SHARED | SND_CONFIG_SETTLED | SND_CONFIG_LOADING)
+
+/* iterates the children without loading pending card configurations */
+#define snd_config_for_each_raw(pos, next, node) \
+	for (pos = (node)->u.compound.fields.next, next = pos->next; \
+	     pos != &(node)->u.compound.fields; pos = next, next = pos->next)
+
+/*
+ * Whole trees created by the parser, snd_config_copy() and
+ * snd_config_expand() are allocated from an arena.  Each node records
+ * its arena and which of its strings live there, so nodes can still be
+ * moved between trees and modified.  The arena is freed with the last
+ * node allocated from it.  Deleted nodes and replaced strings go to
+ * free lists by size and are reused by the next allocations of the
+ * same size, so a tree that is modified for a long time does not grow.
+ * Copies duplicate the strings into their own arena, a copy never keeps
+ * the arena of its source alive.
+ */
+struct snd_config_arena_chunk {
+	struct snd_config_arena_chunk *next;
+};
+
+struct snd_config_arena_free {
+	struct snd_config_arena_free *next;
+};
+
+/* allocations up to this many alignment units are reused */
+#define SND_CONFIG_ARENA_CLASSES	32
+
+struct snd_config_arena {
+	unsigned int refs;		/* creator and live nodes */
+	size_t chunk_size;		/* size of the next chunk */
+	char *ptr;			/* free space in the current chunk */
+	size_t avail;
+	struct snd_config_arena_chunk *chunks;
+	struct snd_config_arena_free *free[SND_CONFIG_ARENA_CLASSES];
+};
+
+#define SND_CONFIG_ARENA_ALIGN		__alignof__(snd_config_t)
+#define SND_CONFIG_ARENA_ROUND(size)	(((size) + SND_CONFIG_ARENA_ALIGN - 1) & \
+					 ~(SND_CONFIG_ARENA_ALIGN - 1))
+#define SND_CONFIG_ARENA_CHUNK_MIN	1024
+#define SND_CONFIG_ARENA_CHUNK_MAX	(64 * 1024)
+
+/* compounds with fewer children are searched linearly */
+#define SND_CONFIG_INDEX_MIN	16
+
+/* a card configuration deferred by snd_config_hook_load_for_all_cards() */
+struct snd_config_lazy {
+	char *driver;			/* id of the driver namespace */
+	snd_config_t *hook;		/* copy of the hook definition */
+	struct snd_config_lazy *next;
 };
 
+#define FILEDESC_BUFSIZE	16384
+
 struct filedesc {
 	char *name;
 	snd_input_t *in;
 	unsigned int line, column;
 	struct filedesc *next;
+	const unsigned char *ptr, *end;	/* unread part of buf */
+	unsigned char buf[FILEDESC_BUFSIZE];
 };
 
 #define LOCAL_ERROR			(-0x68000000)
@@ -458,12 +535,138 @@ struct filedesc {
 #define LOCAL_UNEXPECTED_CHAR		(LOCAL_ERROR - 2)
 #define LOCAL_UNEXPECTED_EOF		(LOCAL_ERROR - 3)
 
+struct finfo {
+	char *name;
+	dev_t dev;
+	ino_t ino;
+	time_t mtime;
+};
+
+struct _snd_config_update {
+	unsigned int count;
+	struct finfo *finfo;
+	char *configs;		/* watched file list, NULL if not watched */
+	char *targets;		/* resolved paths of symlinked files, or NULL */
+	int notify_fd;		/* inotify descriptor, valid with configs */
+	pid_t notify_pid;	/* process which created the descriptor */
+	int incomplete;		/* a dependency could not be recorded */
+};
+
 typedef struct {
 	struct filedesc *current;
 	int unget;
 	int ch;
+	snd_config_update_t *deps;	/* records included files, may be NULL */
+	struct snd_config_arena *arena;	/* allocator of strings, NULL for malloc */
 } input_t;
 
+static struct snd_config_arena *snd_config_arena_new(void)
+{
+	struct snd_config_arena *arena = calloc(1, sizeof(*arena));
+	if (arena) {
+		arena->refs = 1;
+		arena->chunk_size = SND_CONFIG_ARENA_CHUNK_MIN;
+	}
+	return arena;
+}
+
+static void snd_config_arena_put(struct snd_config_arena *arena)
+{
+	struct snd_config_arena_chunk *chunk, *next;
+	if (--arena->refs > 0)
+		return;
+	for (chunk = arena->chunks; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	free(arena);
+}
+
+static void *snd_config_arena_alloc(struct snd_config_arena *arena, size_t size)
+{
+	char *ptr;
+	size = SND_CONFIG_ARENA_ROUND(size);
+	if (size <= SND_CONFIG_ARENA_CLASSES * SND_CONFIG_ARENA_ALIGN) {
+		struct snd_config_arena_free **f;
+		f = &arena->free[size / SND_CONFIG_ARENA_ALIGN - 1];
+		if (*f) {
+			ptr = (char *)*f;
+			*f = (*f)->next;
+			return ptr;
+		}
+	}
+	if (size > arena->avail) {
+		struct snd_config_arena_chunk *chunk;
+		size_t hdr = SND_CONFIG_ARENA_ROUND(sizeof(*chunk));
+		size_t csize = arena->chunk_size;
+		if (csize < size)
+			csize = size;
+		chunk = malloc(hdr + csize);
+		if (!chunk)
+			return NULL;
+		chunk->next = arena->chunks;
+		arena->chunks = chunk;
+		arena->ptr = (char *)chunk + hdr;
+		arena->avail = csize;
+		if (arena->chunk_size < SND_CONFIG_ARENA_CHUNK_MAX)
+			arena->chunk_size *= 2;
+	}
+	ptr = arena->ptr;
+	arena->ptr += size;
+	arena->avail -= size;
+	return ptr;
+}
+
+static char *snd_config_arena_strdup(struct snd_config_arena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *dst = snd_config_arena_alloc(arena, len);
+	if (dst)
+		memcpy(dst, str, len);
+	return dst;
+}
+
+/* gives back an allocation of the given size for reuse */
+static void snd_config_arena_free(struct snd_config_arena *arena, void *ptr, size_t size)
+{
+	struct snd_config_arena_free *f = ptr;
+	size = SND_CONFIG_ARENA_ROUND(size);
+	if ((char *)ptr + size == arena->ptr) {
+		/* the last allocation */
+		arena->ptr = ptr;
+		arena->avail += size;
+		return;
+	}
+	if (size > SND_CONFIG_ARENA_CLASSES * SND_CONFIG_ARENA_ALIGN)
+		return;
+	f->next = arena->free[size / SND_CONFIG_ARENA_ALIGN - 1];
+	arena->free[size / SND_CONFIG_ARENA_ALIGN - 1] = f;
+}
+
+static void snd_config_arena_free_string(struct snd_config_arena *arena, char *str)
+{
+	snd_config_arena_free(arena, str, strlen(str) + 1);
+}
+
+static char *input_strdup(input_t *input, const char *str)
+{
+	if (input->arena)
+		return snd_config_arena_strdup(input->arena, str);
+	return strdup(str);
+}
+
+static void input_free(input_t *input, char *str)
+{
+	if (!str)
+		return;
+	if (input->arena)
+		snd_config_arena_free_string(input->arena, str);
+	else
+		free(str);
+}
+
+static int snd_config_update_add(snd_config_update_t *update, const char *name);
+
 static int safe_strtoll(const char *str, long long *val)
 {
 	long long v;
@@ -523,17 +726,18 @@ static int safe_strtod(const char *str, double *val)
 	return 0;
 }
 
-static int get_char(input_t *input)
+static int filedesc_fill(struct filedesc *fd)
+{
+	ssize_t res = snd_input_read(fd->in, fd->buf, sizeof(fd->buf));
+	if (res <= 0)
+		return 0;
+	fd->ptr = fd->buf;
+	fd->end = fd->buf + res;
+	return 1;
+}
+
+static inline void filedesc_advance(struct filedesc *fd, int c)
 {
-	int c;
-	struct filedesc *fd;
-	if (input->unget) {
-		input->unget = 0;
-		return input->ch;
-	}
- again:
-	fd = input->current;
-	c = snd_input_getc(fd->in);
 	switch (c) {
 	case '\n':
 		fd->column = 0;
@@ -542,7 +746,23 @@ static int get_char(input_t *input)
 	case '\t':
 		fd->column += 8 - fd->column % 8;
 		break;
-	case EOF:
+	default:
+		fd->column++;
+		break;
+	}
+}
+
+static inline int get_char(input_t *input)
+{
+	int c;
+	struct filedesc *fd;
+	if (input->unget) {
+		input->unget = 0;
+		return input->ch;
+	}
+ again:
+	fd = input->current;
+	if (fd->ptr == fd->end && !filedesc_fill(fd)) {
 		if (fd->next) {
 			snd_input_close(fd->in);
 			free(fd->name);
@@ -551,11 +771,32 @@ static int get_char(input_t *input)
 			goto again;
 		}
 		return LOCAL_UNEXPECTED_EOF;
-	default:
-		fd->column++;
-		break;
 	}
-	return (unsigned char)c;
+	c = *fd->ptr++;
+	filedesc_advance(fd, c);
+	return c;
+}
+
+/*
+ * Returns the length of the run of buffered characters which are not
+ * in the stop set; the caller consumes them with skip_run().  Runs
+ * never contain '\n' or '\t', so the column simply advances.
+ */
+static inline size_t buffered_run(input_t *input, const unsigned char *stop)
+{
+	struct filedesc *fd = input->current;
+	const unsigned char *p;
+	if (input->unget)
+		return 0;
+	for (p = fd->ptr; p < fd->end && !stop[*p]; p++)
+		;
+	return p - fd->ptr;
+}
+
+static inline void skip_run(input_t *input, size_t len)
+{
+	input->current->ptr += len;
+	input->current->column += len;
 }
 
 static void unget_char(int c, input_t *input)
@@ -576,7 +817,12 @@ static int get_char_skip_comments(input_t *input)
 			char *str;
 			snd_input_t *in;
 			struct filedesc *fd;
-			int err = get_delimstring(&str, '>', input);
+			struct snd_config_arena *arena = input->arena;
+			int err;
+			/* the file name is not a part of the tree */
+			input->arena = NULL;
+			err = get_delimstring(&str, '>', input);
+			input->arena = arena;
 			if (err < 0)
 				return err;
 			if (!strncmp(str, "confdir:", 8)) {
@@ -605,12 +851,30 @@ static int get_char_skip_comments(input_t *input)
 			fd->next = input->current;
 			fd->line = 1;
 			fd->column = 0;
+			fd->ptr = fd->end = fd->buf;
 			input->current = fd;
+			if (input->deps &&
+			    snd_config_update_add(input->deps, str) < 0) {
+				/* not fatal, the cache is just not written */
+				input->deps->incomplete = 1;
+				input->deps = NULL;
+			}
 			continue;
 		}
 		if (c != '#')
 			break;
 		while (1) {
+			struct filedesc *fd = input->current;
+			const unsigned char *nl;
+			if (!input->unget && fd->ptr < fd->end) {
+				nl = memchr(fd->ptr, '\n', fd->end - fd->ptr);
+				if (nl) {
+					fd->ptr = nl + 1;
+					fd->line++;
+					fd->column = 0;
+					break;
+				}
+			}
 			c = get_char(input);
 			if (c < 0)
 				return c;
@@ -720,9 +984,38 @@ static int add_char_local_string(struct local_string *s, int c)
 	return 0;
 }
 
-static char *copy_local_string(struct local_string *s)
+static int add_chars_local_string(struct local_string *s, const unsigned char *chars,
+				  size_t len)
+{
+	if (s->idx + len > s->alloc) {
+		size_t nalloc = s->alloc * 2;
+		while (nalloc < s->idx + len)
+			nalloc *= 2;
+		if (s->buf == s->tmpbuf) {
+			s->buf = malloc(nalloc);
+			if (s->buf == NULL)
+				return -ENOMEM;
+			memcpy(s->buf, s->tmpbuf, s->idx);
+		} else {
+			char *ptr = realloc(s->buf, nalloc);
+			if (ptr == NULL)
+				return -ENOMEM;
+			s->buf = ptr;
+		}
+		s->alloc = nalloc;
+	}
+	memcpy(s->buf + s->idx, chars, len);
+	s->idx += len;
+	return 0;
+}
+
+static char *copy_local_string(struct local_string *s, input_t *input)
 {
-	char *dst = malloc(s->idx + 1);
+	char *dst;
+	if (input->arena)
+		dst = snd_config_arena_alloc(input->arena, s->idx + 1);
+	else
+		dst = malloc(s->idx + 1);
 	if (dst) {
 		memcpy(dst, s->buf, s->idx);
 		dst[s->idx] = '\0';
@@ -730,17 +1023,37 @@ static char *copy_local_string(struct local_string *s)
 	return dst;
 }
 
+#define FREESTRING_STOP \
+	[' '] = 1, ['\f'] = 1, ['\t'] = 1, ['\n'] = 1, ['\r'] = 1, \
+	['='] = 1, [','] = 1, [';'] = 1, ['{'] = 1, ['}'] = 1, \
+	['['] = 1, [']'] = 1, ['\''] = 1, ['"'] = 1, ['\\'] = 1, ['#'] = 1
+
+/* characters terminating a free string, '.' also terminates ids */
+static const unsigned char freestring_stop[256] = { FREESTRING_STOP };
+static const unsigned char freestring_id_stop[256] = { FREESTRING_STOP, ['.'] = 1 };
+
 static int get_freestring(char **string, int id, input_t *input)
 {
 	struct local_string str;
+	const unsigned char *stop = id ? freestring_id_stop : freestring_stop;
+	size_t len;
 	int c;
 
 	init_local_string(&str);
 	while (1) {
+		len = buffered_run(input, stop);
+		if (len > 0) {
+			if (add_chars_local_string(&str, input->current->ptr, len) < 0) {
+				c = -ENOMEM;
+				break;
+			}
+			skip_run(input, len);
+			continue;
+		}
 		c = get_char(input);
 		if (c < 0) {
 			if (c == LOCAL_UNEXPECTED_EOF) {
-				*string = copy_local_string(&str);
+				*string = copy_local_string(&str, input);
 				if (! *string)
 					c = -ENOMEM;
 				else
@@ -768,7 +1081,7 @@ static int get_freestring(char **string, int id, input_t *input)
 		case '"':
 		case '\\':
 		case '#':
-			*string = copy_local_string(&str);
+			*string = copy_local_string(&str, input);
 			if (! *string)
 				c = -ENOMEM;
 			else {
@@ -792,10 +1105,23 @@ static int get_freestring(char **string, int id, input_t *input)
 static int get_delimstring(char **string, int delim, input_t *input)
 {
 	struct local_string str;
+	unsigned char stop[256];
+	size_t len;
 	int c;
 
+	memset(stop, 0, sizeof(stop));
+	stop['\\'] = stop['\n'] = stop['\t'] = stop[(unsigned char)delim] = 1;
 	init_local_string(&str);
 	while (1) {
+		len = buffered_run(input, stop);
+		if (len > 0) {
+			if (add_chars_local_string(&str, input->current->ptr, len) < 0) {
+				c = -ENOMEM;
+				break;
+			}
+			skip_run(input, len);
+			continue;
+		}
 		c = get_char(input);
 		if (c < 0)
 			break;
@@ -806,7 +1132,7 @@ static int get_delimstring(char **string, int delim, input_t *input)
 			if (c == '\n')
 				continue;
 		} else if (c == delim) {
-			*string = copy_local_string(&str);
+			*string = copy_local_string(&str, input);
 			if (! *string)
 				c = -ENOMEM;
 			else
@@ -854,14 +1180,26 @@ static int get_string(char **string, int id, input_t *input)
 	}
 }
 
-static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type)
+/* if arena is not NULL, *id must be allocated from it */
+static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t type,
+			    struct snd_config_arena *arena)
 {
 	snd_config_t *n;
 	assert(config);
-	n = calloc(1, sizeof(*n));
+	if (arena) {
+		n = snd_config_arena_alloc(arena, sizeof(*n));
+		if (n) {
+			memset(n, 0, sizeof(*n));
+			n->arena = arena;
+			arena->refs++;
+		}
+	} else {
+		n = calloc(1, sizeof(*n));
+	}
 	if (n == NULL) {
-		if (*id) {
-			free(*id);
+		if (id && *id) {
+			if (!arena)
+				free(*id);
 			*id = NULL;
 		}
 		return -ENOMEM;
@@ -869,6 +1207,8 @@ static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t
 	if (id) {
 		n->id = *id;
 		*id = NULL;
+		if (n->id && arena)
+			n->flags |= SND_CONFIG_ARENA_ID;
 	}
 	n->type = type;
 	if (type == SND_CONFIG_TYPE_COMPOUND)
@@ -878,26 +1218,235 @@ static int _snd_config_make(snd_config_t **config, char **id, snd_config_type_t
 }
 	
 
+/* duplicates str for storing in a node allocated from arena (or malloc) */
+static char *snd_config_dup_str(struct snd_config_arena *arena, const char *str)
+{
+	return arena ? snd_config_arena_strdup(arena, str) : strdup(str);
+}
+
+/* creates a node with the id of src in the given arena (or malloc) */
+static int snd_config_make_like(struct snd_config_arena *arena, snd_config_t **config,
+				const snd_config_t *src, snd_config_type_t type)
+{
+	char *id1 = NULL;
+	if (src->id) {
+		id1 = snd_config_dup_str(arena, src->id);
+		if (!id1)
+			return -ENOMEM;
+	}
+	return _snd_config_make(config, &id1, type, arena);
+}
+
+static void snd_config_free_id(snd_config_t *n)
+{
+	if (!(n->flags & SND_CONFIG_ARENA_ID))
+		free(n->id);
+	else
+		snd_config_arena_free_string(n->arena, n->id);
+	n->flags &= ~SND_CONFIG_ARENA_ID;
+	n->id = NULL;
+}
+
+static void snd_config_free_string(snd_config_t *n)
+{
+	if (!(n->flags & SND_CONFIG_ARENA_STRING))
+		free(n->u.string);
+	else
+		snd_config_arena_free_string(n->arena, n->u.string);
+	n->flags &= ~SND_CONFIG_ARENA_STRING;
+	n->u.string = NULL;
+}
+
+/* stores a copy of the string value of src in the node */
+static int snd_config_copy_string(snd_config_t *n, const snd_config_t *src)
+{
+	char *dst = NULL;
+	snd_config_free_string(n);
+	if (src->u.string) {
+		dst = snd_config_dup_str(n->arena, src->u.string);
+		if (!dst)
+			return -ENOMEM;
+		if (n->arena)
+			n->flags |= SND_CONFIG_ARENA_STRING;
+	}
+	n->u.string = dst;
+	return 0;
+}
+
+/* moves the strings allocated from the arena of the node to the heap */
+static int snd_config_unshare(snd_config_t *n)
+{
+	char *str;
+	if (n->flags & SND_CONFIG_ARENA_ID) {
+		str = strdup(n->id);
+		if (!str)
+			return -ENOMEM;
+		snd_config_arena_free_string(n->arena, n->id);
+		n->id = str;
+		n->flags &= ~SND_CONFIG_ARENA_ID;
+	}
+	if (n->flags & SND_CONFIG_ARENA_STRING) {
+		str = strdup(n->u.string);
+		if (!str)
+			return -ENOMEM;
+		snd_config_arena_free_string(n->arena, n->u.string);
+		n->u.string = str;
+		n->flags &= ~SND_CONFIG_ARENA_STRING;
+	}
+	return 0;
+}
+
+/* frees the node structure itself */
+static void snd_config_release(snd_config_t *n)
+{
+	if (n->arena) {
+		snd_config_arena_free(n->arena, n, sizeof(*n));
+		snd_config_arena_put(n->arena);
+	} else {
+		free(n);
+	}
+}
+
+/*
+ * The children of large compounds are additionally kept in a chained
+ * hash table.  The table is created by snd_config_link() when the
+ * compound gets SND_CONFIG_INDEX_MIN children and maintained by
+ * snd_config_link()/snd_config_unlink() afterwards, so searches never
+ * modify the tree.  The list of children stays authoritative for the
+ * iteration order.
+ */
+static unsigned int snd_config_hash(const char *id, size_t len)
+{
+	unsigned int hash = 2166136261U;
+	while (len-- > 0)
+		hash = (hash ^ (unsigned char)*id++) * 16777619U;
+	return hash;
+}
+
+static void snd_config_index_insert(snd_config_t *config, snd_config_t *n)
+{
+	snd_config_t **p;
+	p = &config->u.compound.index[snd_config_hash(n->id, strlen(n->id)) &
+				      (config->u.compound.buckets - 1)];
+	/* append, so that the first matching node in the list is found */
+	while (*p)
+		p = &(*p)->hash_next;
+	n->hash_next = NULL;
+	*p = n;
+}
+
+static void snd_config_index_remove(snd_config_t *config, snd_config_t *n)
+{
+	snd_config_t **p;
+	p = &config->u.compound.index[snd_config_hash(n->id, strlen(n->id)) &
+				      (config->u.compound.buckets - 1)];
+	while (*p != n)
+		p = &(*p)->hash_next;
+	*p = n->hash_next;
+	n->hash_next = NULL;
+}
+
+static void snd_config_index_free(snd_config_t *config)
+{
+	free(config->u.compound.index);
+	config->u.compound.index = NULL;
+	config->u.compound.buckets = 0;
+}
+
+static int snd_config_index_build(snd_config_t *config, unsigned int buckets)
+{
+	snd_config_iterator_t i, next;
+	snd_config_t **index;
+
+	index = calloc(buckets, sizeof(*index));
+	if (!index)
+		return -ENOMEM;
+	free(config->u.compound.index);
+	config->u.compound.index = index;
+	config->u.compound.buckets = buckets;
+	snd_config_for_each_raw(i, next, config)
+		snd_config_index_insert(config, snd_config_iterator_entry(i));
+	return 0;
+}
+
+/* creates the index once the compound is large enough */
+static void snd_config_index_check(snd_config_t *config)
+{
+	if (config->u.compound.count >= SND_CONFIG_INDEX_MIN) {
+		unsigned int buckets = SND_CONFIG_INDEX_MIN;
+		while (buckets < config->u.compound.count)
+			buckets *= 2;
+		/* on failure, the next link tries again */
+		snd_config_index_build(config, buckets);
+	}
+}
+
+static void snd_config_link(snd_config_t *parent, snd_config_t *n)
+{
+	n->parent = parent;
+	list_add_tail(&n->list, &parent->u.compound.fields);
+	parent->u.compound.count++;
+	if (!parent->u.compound.index) {
+		snd_config_index_check(parent);
+		return;
+	}
+	if (parent->u.compound.count > parent->u.compound.buckets) {
+		/* the rebuilt index already contains n */
+		if (snd_config_index_build(parent, parent->u.compound.buckets * 2) < 0)
+			snd_config_index_free(parent);	/* linear search */
+		return;
+	}
+	snd_config_index_insert(parent, n);
+}
+
+static void snd_config_unlink(snd_config_t *n)
+{
+	snd_config_t *parent = n->parent;
+	list_del(&n->list);
+	parent->u.compound.count--;
+	if (parent->u.compound.index)
+		snd_config_index_remove(parent, n);
+}
+
 static int _snd_config_make_add(snd_config_t **config, char **id,
-				snd_config_type_t type, snd_config_t *parent)
+				snd_config_type_t type, snd_config_t *parent,
+				struct snd_config_arena *arena)
 {
 	snd_config_t *n;
 	int err;
 	assert(parent->type == SND_CONFIG_TYPE_COMPOUND);
-	err = _snd_config_make(&n, id, type);
+	err = _snd_config_make(&n, id, type, arena);
 	if (err < 0)
 		return err;
-	n->parent = parent;
-	list_add_tail(&n->list, &parent->u.compound.fields);
+	snd_config_link(parent, n);
 	*config = n;
 	return 0;
 }
 
-static int _snd_config_search(snd_config_t *config, 
-			      const char *id, int len, snd_config_t **result)
+static int snd_config_lazy_load(snd_config_t *config, const char *id, size_t len);
+static void snd_config_lazy_free(snd_config_t *config);
+static int snd_config_hooks(snd_config_t *config, snd_config_t *private_data);
+
+/* searches the present children only */
+static int snd_config_lookup(snd_config_t *config,
+			     const char *id, int len, snd_config_t **result)
 {
 	snd_config_iterator_t i, next;
-	snd_config_for_each(i, next, config) {
+	if (config->u.compound.index) {
+		size_t l = len < 0 ? strlen(id) : (size_t) len;
+		snd_config_t *n;
+		n = config->u.compound.index[snd_config_hash(id, l) &
+					     (config->u.compound.buckets - 1)];
+		for (; n; n = n->hash_next) {
+			if (strncmp(n->id, id, l) == 0 && n->id[l] == '\0') {
+				if (result)
+					*result = n;
+				return 0;
+			}
+		}
+		return -ENOENT;
+	}
+	snd_config_for_each_raw(i, next, config) {
 		snd_config_t *n = snd_config_iterator_entry(i);
 		if (len < 0) {
 			if (strcmp(n->id, id) != 0)
@@ -912,36 +1461,234 @@ static int _snd_config_search(snd_config_t *config,
 	return -ENOENT;
 }
 
-static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input, char **id, int skip)
+/*
+ * Searches in a published tree still run the hooks of compounds and
+ * load deferred card configurations.  In a shared tree,
+ * this happens under snd_config_shared_mutex, which is recursive since
+ * hooks search the tree again.  Compounds with nothing pending are
+ * marked settled and are searched without the lock.
+ */
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t snd_config_shared_mutex;
+static pthread_once_t snd_config_shared_once = PTHREAD_ONCE_INIT;
+
+static void snd_config_shared_init(void)
 {
-	snd_config_t *n = *_n;
-	char *s;
-	int err;
+	pthread_mutexattr_t attr;
 
-	err = get_string(&s, 0, input);
-	if (err < 0)
-		return err;
-	if (skip) {
-		free(s);
-		return 0;
-	}
-	if (err == 0 && ((s[0] >= '0' && s[0] <= '9') || s[0] == '-')) {
-		long long i;
-		errno = 0;
-		err = safe_strtoll(s, &i);
-		if (err < 0) {
-			double r;
-			err = safe_strtod(s, &r);
-			if (err >= 0) {
-				free(s);
-				if (n) {
-					if (n->type != SND_CONFIG_TYPE_REAL) {
-						SNDERR("%s is not a real", *id);
-						return -EINVAL;
-					}
-				} else {
-					err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_REAL, parent);
-					if (err < 0)
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+	pthread_mutex_init(&snd_config_shared_mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+#endif
+
+static inline void snd_config_shared_lock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_once(&snd_config_shared_once, snd_config_shared_init);
+	pthread_mutex_lock(&snd_config_shared_mutex);
+#endif
+}
+
+static inline void snd_config_shared_unlock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&snd_config_shared_mutex);
+#endif
+}
+
+/* true for a compound of a shared tree which searches may still modify */
+static inline int snd_config_unsettled(snd_config_t *config)
+{
+	unsigned int flags = __atomic_load_n(&config->flags, __ATOMIC_ACQUIRE);
+	return (flags & (SND_CONFIG_SHARED | SND_CONFIG_SETTLED)) == SND_CONFIG_SHARED;
+}
+
+/*
+ * Marks the compounds of a tree as shared.
+ * Hooks and card loads parse into the whole subtree of their compound,
+ * so a compound is settled only when neither it nor any of its parents
+ * has something pending.  The flags of a compound are stored after
+ * those of its children, a search never reaches an unshared compound
+ * without the lock.  Called before the tree is published or with the
+ * shared lock held.
+ */
+static void snd_config_share1(snd_config_t *config, int settled)
+{
+	snd_config_iterator_t i, next;
+	unsigned int flags;
+
+	if (config->type != SND_CONFIG_TYPE_COMPOUND)
+		return;
+	/* settled subtrees do not change anymore */
+	if (config->flags & SND_CONFIG_SETTLED)
+		return;
+	if (config->u.compound.lazy || (config->flags & SND_CONFIG_LOADING) ||
+	    snd_config_lookup(config, "@hooks", -1, NULL) >= 0)
+		settled = 0;
+	snd_config_for_each_raw(i, next, config)
+		snd_config_share1(snd_config_iterator_entry(i), settled);
+	flags = config->flags | SND_CONFIG_SHARED;
+	if (settled)
+		flags |= SND_CONFIG_SETTLED;
+	else
+		flags &= ~SND_CONFIG_SETTLED;
+	if (flags != config->flags)
+		__atomic_store_n(&config->flags, flags, __ATOMIC_RELEASE);
+}
+
+static void snd_config_share(snd_config_t *config)
+{
+	snd_config_t *parent = config->parent;
+	snd_config_share1(config, !parent || (parent->flags & SND_CONFIG_SETTLED));
+}
+
+/*
+ * Hooks and card loads search the tree again.  Only the outermost one
+ * marks the compound and shares it afterwards, the nested searches must
+ * not settle the compound before it is finished.  Returns zero when the
+ * compound is already being loaded.
+ */
+static int snd_config_loading(snd_config_t *config, int loading)
+{
+	unsigned int flags = config->flags;
+	if (loading) {
+		if (flags & SND_CONFIG_LOADING)
+			return 0;
+		flags |= SND_CONFIG_LOADING;
+	} else {
+		flags &= ~SND_CONFIG_LOADING;
+	}
+	__atomic_store_n(&config->flags, flags, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/*
+ * Loads the pending card configurations which may define the id, all
+ * of them for a NULL id.
+ */
+static int snd_config_lazy_run(snd_config_t *config, const char *id, int len)
+{
+	size_t l = id && len < 0 ? strlen(id) : (size_t) len;
+	int err = 0, outer;
+
+	if (!snd_config_unsettled(config))
+		return config->u.compound.lazy ? snd_config_lazy_load(config, id, l) : 0;
+	snd_config_shared_lock();
+	if (config->u.compound.lazy) {
+		outer = snd_config_loading(config, 1);
+		err = snd_config_lazy_load(config, id, l);
+		if (outer) {
+			snd_config_loading(config, 0);
+			if (err != 0)
+				snd_config_share(config);
+		}
+	}
+	snd_config_shared_unlock();
+	return err;
+}
+
+static int _snd_config_search(snd_config_t *config,
+			      const char *id, int len, snd_config_t **result)
+{
+	int err;
+
+	if (!snd_config_unsettled(config)) {
+		if (config->u.compound.lazy) {
+			err = snd_config_lazy_run(config, id, len);
+			if (err < 0)
+				return err;
+		}
+		return snd_config_lookup(config, id, len, result);
+	}
+	snd_config_shared_lock();
+	err = snd_config_lazy_run(config, id, len);
+	if (err >= 0)
+		err = snd_config_lookup(config, id, len, result);
+	snd_config_shared_unlock();
+	return err;
+}
+
+/*
+ * The children of a compound being iterated must not change, so the
+ * iteration of a shared compound first runs what is pending in it and
+ * in its parents, whose hooks parse into it as well.
+ */
+static void snd_config_settle(snd_config_t *config)
+{
+	snd_config_t *parent;
+	int outer;
+
+	snd_config_shared_lock();
+	if (snd_config_unsettled(config)) {
+		parent = config->parent;
+		if (parent && snd_config_unsettled(parent))
+			snd_config_settle(parent);
+		outer = snd_config_loading(config, 1);
+		snd_config_hooks(config, NULL);
+		/* every load consumes its entry, even a failing one */
+		while (config->u.compound.lazy)
+			snd_config_lazy_load(config, NULL, 0);
+		if (outer) {
+			snd_config_loading(config, 0);
+			snd_config_share(config);
+		}
+	}
+	snd_config_shared_unlock();
+}
+
+/* runs the hooks of a compound searched with the hook expanding functions */
+static int snd_config_search_hooks_run(snd_config_t *config)
+{
+	int err, outer;
+
+	if (!snd_config_unsettled(config)) {
+		if (__atomic_load_n(&config->flags, __ATOMIC_RELAXED) & SND_CONFIG_SHARED)
+			return 0;
+		return snd_config_hooks(config, NULL);
+	}
+	snd_config_shared_lock();
+	outer = snd_config_loading(config, 1);
+	err = snd_config_hooks(config, NULL);
+	if (outer) {
+		snd_config_loading(config, 0);
+		snd_config_share(config);
+	}
+	snd_config_shared_unlock();
+	return err;
+}
+
+static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input, char **id, int skip)
+{
+	snd_config_t *n = *_n;
+	char *s;
+	int err;
+
+	err = get_string(&s, 0, input);
+	if (err < 0)
+		return err;
+	if (skip) {
+		input_free(input, s);
+		return 0;
+	}
+	if (err == 0 && ((s[0] >= '0' && s[0] <= '9') || s[0] == '-')) {
+		long long i;
+		errno = 0;
+		err = safe_strtoll(s, &i);
+		if (err < 0) {
+			double r;
+			err = safe_strtod(s, &r);
+			if (err >= 0) {
+				input_free(input, s);
+				if (n) {
+					if (n->type != SND_CONFIG_TYPE_REAL) {
+						SNDERR("%s is not a real", *id);
+						return -EINVAL;
+					}
+				} else {
+					err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_REAL, parent, input->arena);
+					if (err < 0)
 						return err;
 				}
 				n->u.real = r;
@@ -949,7 +1696,7 @@ static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input,
 				return 0;
 			}
 		} else {
-			free(s);
+			input_free(input, s);
 			if (n) {
 				if (n->type != SND_CONFIG_TYPE_INTEGER && n->type != SND_CONFIG_TYPE_INTEGER64) {
 					SNDERR("%s is not an integer", *id);
@@ -957,9 +1704,9 @@ static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input,
 				}
 			} else {
 				if (i <= INT_MAX) 
-					err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_INTEGER, parent);
+					err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_INTEGER, parent, input->arena);
 				else
-					err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_INTEGER64, parent);
+					err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_INTEGER64, parent, input->arena);
 				if (err < 0)
 					return err;
 			}
@@ -974,16 +1721,26 @@ static int parse_value(snd_config_t **_n, snd_config_t *parent, input_t *input,
 	if (n) {
 		if (n->type != SND_CONFIG_TYPE_STRING) {
 			SNDERR("%s is not a string", *id);
-			free(s);
+			input_free(input, s);
 			return -EINVAL;
 		}
 	} else {
-		err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_STRING, parent);
+		err = _snd_config_make_add(&n, id, SND_CONFIG_TYPE_STRING, parent, input->arena);
 		if (err < 0)
 			return err;
 	}
-	free(n->u.string);
-	n->u.string = s;
+	snd_config_free_string(n);
+	if (input->arena && input->arena != n->arena) {
+		/* the node was not created by this parser */
+		n->u.string = strdup(s);
+		input_free(input, s);
+		if (!n->u.string)
+			return -ENOMEM;
+	} else {
+		n->u.string = s;
+		if (input->arena)
+			n->flags |= SND_CONFIG_ARENA_STRING;
+	}
 	*_n = n;
 	return 0;
 }
@@ -1001,7 +1758,7 @@ static int parse_array_def(snd_config_t *parent, input_t *input, int idx, int sk
 	if (!skip) {
 		char static_id[12];
 		snprintf(static_id, sizeof(static_id), "%i", idx);
-		id = strdup(static_id);
+		id = input_strdup(input, static_id);
 		if (id == NULL)
 			return -ENOMEM;
 	}
@@ -1023,7 +1780,7 @@ static int parse_array_def(snd_config_t *parent, input_t *input, int idx, int sk
 					goto __end;
 				}
 			} else {
-				err = _snd_config_make_add(&n, &id, SND_CONFIG_TYPE_COMPOUND, parent);
+				err = _snd_config_make_add(&n, &id, SND_CONFIG_TYPE_COMPOUND, parent, input->arena);
 				if (err < 0)
 					goto __end;
 			}
@@ -1057,7 +1814,7 @@ static int parse_array_def(snd_config_t *parent, input_t *input, int idx, int sk
 	}
 	err = 0;
       __end:
-	free(id);
+	input_free(input, id);
       	return err;
 }
 
@@ -1113,13 +1870,13 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 		if (c != '.')
 			break;
 		if (skip) {
-			free(id);
+			input_free(input, id);
 			continue;
 		}
-		if (_snd_config_search(parent, id, -1, &n) == 0) {
+		if (snd_config_lookup(parent, id, -1, &n) == 0) {
 			if (mode == DONT_OVERRIDE) {
 				skip = 1;
-				free(id);
+				input_free(input, id);
 				continue;
 			}
 			if (mode != OVERRIDE) {
@@ -1129,7 +1886,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 				}
 				n->u.compound.join = 1;
 				parent = n;
-				free(id);
+				input_free(input, id);
 				continue;
 			}
 			snd_config_delete(n);
@@ -1139,7 +1896,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 			err = -ENOENT;
 			goto __end;
 		}
-		err = _snd_config_make_add(&n, &id, SND_CONFIG_TYPE_COMPOUND, parent);
+		err = _snd_config_make_add(&n, &id, SND_CONFIG_TYPE_COMPOUND, parent, input->arena);
 		if (err < 0)
 			goto __end;
 		n->u.compound.join = 1;
@@ -1151,7 +1908,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 			return c;
 	}
 	if (!skip) {
-		if (_snd_config_search(parent, id, -1, &n) == 0) {
+		if (snd_config_lookup(parent, id, -1, &n) == 0) {
 			if (mode == DONT_OVERRIDE) {
 				skip = 1;
 				n = NULL;
@@ -1181,7 +1938,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 					goto __end;
 				}
 			} else {
-				err = _snd_config_make_add(&n, &id, SND_CONFIG_TYPE_COMPOUND, parent);
+				err = _snd_config_make_add(&n, &id, SND_CONFIG_TYPE_COMPOUND, parent, input->arena);
 				if (err < 0)
 					goto __end;
 			}
@@ -1218,7 +1975,7 @@ static int parse_def(snd_config_t *parent, input_t *input, int skip, int overrid
 		unget_char(c, input);
 	}
       __end:
-	free(id);
+	input_free(input, id);
 	return err;
 }
 		
@@ -1433,26 +2190,50 @@ static int _snd_config_save_children(snd_config_t *config, snd_output_t *out,
 int snd_config_substitute(snd_config_t *dst, snd_config_t *src)
 {
 	assert(dst && src);
+	if (src->arena != dst->arena) {
+		/* dst takes over the strings of src */
+		int err = snd_config_unshare(src);
+		if (err < 0)
+			return err;
+	}
 	if (dst->type == SND_CONFIG_TYPE_COMPOUND &&
 	    src->type == SND_CONFIG_TYPE_COMPOUND) {	/* append */
 		snd_config_iterator_t i, next;
-		snd_config_for_each(i, next, src) {
+		snd_config_for_each_raw(i, next, src) {
 			snd_config_t *n = snd_config_iterator_entry(i);
 			n->parent = dst;
 		}
 		src->u.compound.fields.next->prev = &dst->u.compound.fields;
 		src->u.compound.fields.prev->next = &dst->u.compound.fields;
+		snd_config_index_free(dst);
+		snd_config_lazy_free(dst);
 	} else if (dst->type == SND_CONFIG_TYPE_COMPOUND) {
 		int err;
 		err = snd_config_delete_compound_members(dst);
 		if (err < 0)
 			return err;
+		snd_config_index_free(dst);
+		snd_config_lazy_free(dst);
+	} else if (dst->type == SND_CONFIG_TYPE_STRING) {
+		snd_config_free_string(dst);
 	}
-	free(dst->id);
-	dst->id = src->id;
+	if (dst->parent && dst->parent->u.compound.index) {
+		/* the id of dst changes, rehash it */
+		snd_config_index_remove(dst->parent, dst);
+		snd_config_free_id(dst);
+		dst->id = src->id;
+		snd_config_index_insert(dst->parent, dst);
+	} else {
+		snd_config_free_id(dst);
+		dst->id = src->id;
+	}
+	/* the sharing state belongs to the place of dst in the tree */
+	__atomic_store_n(&dst->flags,
+			 (src->flags & ~SND_CONFIG_SHARE_MASK) |
+			 (dst->flags & SND_CONFIG_SHARE_MASK), __ATOMIC_RELEASE);
 	dst->type = src->type;
 	dst->u = src->u;
-	free(src);
+	snd_config_release(src);
 	return 0;
 }
 
@@ -1555,17 +2336,14 @@ int snd_config_get_id(const snd_config_t *config, const char **id)
  */
 int snd_config_set_id(snd_config_t *config, const char *id)
 {
-	snd_config_iterator_t i, next;
+	snd_config_t *n;
 	char *new_id;
 	assert(config);
 	if (id) {
-		if (config->parent) {
-			snd_config_for_each(i, next, config->parent) {
-				snd_config_t *n = snd_config_iterator_entry(i);
-				if (n != config && strcmp(id, n->id) == 0)
-					return -EEXIST;
-			}
-		}
+		if (config->parent &&
+		    _snd_config_search(config->parent, id, -1, &n) == 0 &&
+		    n != config)
+			return -EEXIST;
 		new_id = strdup(id);
 		if (!new_id)
 			return -ENOMEM;
@@ -1574,7 +2352,14 @@ int snd_config_set_id(snd_config_t *config, const char *id)
 			return -EINVAL;
 		new_id = NULL;
 	}
-	free(config->id);
+	if (config->parent && config->parent->u.compound.index) {
+		snd_config_index_remove(config->parent, config);
+		snd_config_free_id(config);
+		config->id = new_id;
+		snd_config_index_insert(config->parent, config);
+		return 0;
+	}
+	snd_config_free_id(config);
 	config->id = new_id;
 	return 0;
 }
@@ -1598,10 +2383,25 @@ int snd_config_set_id(snd_config_t *config, const char *id)
 int snd_config_top(snd_config_t **config)
 {
 	assert(config);
-	return _snd_config_make(config, 0, SND_CONFIG_TYPE_COMPOUND);
+	return _snd_config_make(config, 0, SND_CONFIG_TYPE_COMPOUND, NULL);
+}
+
+/* creates a top level node; the tree loaded into it is arena allocated */
+static int snd_config_top_arena(snd_config_t **config)
+{
+	struct snd_config_arena *arena;
+	int err;
+
+	arena = snd_config_arena_new();
+	if (!arena)
+		return -ENOMEM;
+	err = _snd_config_make(config, 0, SND_CONFIG_TYPE_COMPOUND, arena);
+	snd_config_arena_put(arena);
+	return err;
 }
 
-static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
+static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override,
+			    snd_config_update_t *deps)
 {
 	int err;
 	input_t input;
@@ -1615,8 +2415,11 @@ static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
 	fd->line = 1;
 	fd->column = 0;
 	fd->next = NULL;
+	fd->ptr = fd->end = fd->buf;
 	input.current = fd;
 	input.unget = 0;
+	input.deps = deps;
+	input.arena = config->arena;
 	err = parse_defs(config, &input, 0, override);
 	fd = input.current;
 	if (err < 0) {
@@ -1680,7 +2483,7 @@ static int snd_config_load1(snd_config_t *config, snd_input_t *in, int override)
  */
 int snd_config_load(snd_config_t *config, snd_input_t *in)
 {
-	return snd_config_load1(config, in, 0);
+	return snd_config_load1(config, in, 0, NULL);
 }
 
 /**
@@ -1695,7 +2498,7 @@ int snd_config_load(snd_config_t *config, snd_input_t *in)
  */
 int snd_config_load_override(snd_config_t *config, snd_input_t *in)
 {
-	return snd_config_load1(config, in, 1);
+	return snd_config_load1(config, in, 1, NULL);
 }
 
 /**
@@ -1724,17 +2527,12 @@ int snd_config_load_override(snd_config_t *config, snd_input_t *in)
  */
 int snd_config_add(snd_config_t *parent, snd_config_t *child)
 {
-	snd_config_iterator_t i, next;
 	assert(parent && child);
 	if (!child->id || child->parent)
 		return -EINVAL;
-	snd_config_for_each(i, next, parent) {
-		snd_config_t *n = snd_config_iterator_entry(i);
-		if (strcmp(child->id, n->id) == 0)
-			return -EEXIST;
-	}
-	child->parent = parent;
-	list_add_tail(&child->list, &parent->u.compound.fields);
+	if (_snd_config_search(parent, child->id, -1, NULL) == 0)
+		return -EEXIST;
+	snd_config_link(parent, child);
 	return 0;
 }
 
@@ -1755,7 +2553,7 @@ int snd_config_remove(snd_config_t *config)
 {
 	assert(config);
 	if (config->parent)
-		list_del(&config->list);
+		snd_config_unlink(config);
 	config->parent = NULL;
 	return 0;
 }
@@ -1795,18 +2593,20 @@ int snd_config_delete(snd_config_t *config)
 				return err;
 			i = nexti;
 		}
+		snd_config_index_free(config);
+		snd_config_lazy_free(config);
 		break;
 	}
 	case SND_CONFIG_TYPE_STRING:
-		free(config->u.string);
+		snd_config_free_string(config);
 		break;
 	default:
 		break;
 	}
 	if (config->parent)
-		list_del(&config->list);
-	free(config->id);
-	free(config);
+		snd_config_unlink(config);
+	snd_config_free_id(config);
+	snd_config_release(config);
 	return 0;
 }
 
@@ -1878,7 +2678,7 @@ int snd_config_make(snd_config_t **config, const char *id,
 			return -ENOMEM;
 	} else
 		id1 = NULL;
-	return _snd_config_make(config, &id1, type);
+	return _snd_config_make(config, &id1, type, NULL);
 }
 
 /**
@@ -2299,7 +3099,7 @@ int snd_config_set_string(snd_config_t *config, const char *value)
 	} else {
 		new_string = NULL;
 	}
-	free(config->u.string);
+	snd_config_free_string(config);
 	config->u.string = new_string;
 	return 0;
 }
@@ -2387,7 +3187,7 @@ int snd_config_set_ascii(snd_config_t *config, const char *ascii)
 			char *ptr = strdup(ascii);
 			if (ptr == NULL)
 				return -ENOMEM;
-			free(config->u.string);
+			snd_config_free_string(config);
 			config->u.string = ptr;
 		}
 		break;
@@ -3024,8 +3824,6 @@ int snd_config_search_alias(snd_config_t *config,
 				snd_config_searcha, snd_config_searchva);
 }
 
-static int snd_config_hooks(snd_config_t *config, snd_config_t *private_data);
-
 /**
  * \brief Searches for a node in a configuration tree and expands hooks.
  * \param[in,out] config Handle to the root of the configuration
@@ -3051,7 +3849,7 @@ static int snd_config_hooks(snd_config_t *config, snd_config_t *private_data);
 int snd_config_search_hooks(snd_config_t *config, const char *key, snd_config_t **result)
 {
 	SND_CONFIG_SEARCH(config, key, result, \
-					err = snd_config_hooks(config, NULL); \
+					err = snd_config_search_hooks_run(config); \
 					if (err < 0) \
 						return err; \
 			 );
@@ -3085,7 +3883,7 @@ int snd_config_searcha_hooks(snd_config_t *root, snd_config_t *config, const cha
 {
 	SND_CONFIG_SEARCHA(root, config, key, result,
 					snd_config_searcha_hooks,
-					err = snd_config_hooks(config, NULL); \
+					err = snd_config_search_hooks_run(config); \
 					if (err < 0) \
 						return err; \
 			 );
@@ -3158,6 +3956,15 @@ int snd_config_search_alias_hooks(snd_config_t *config,
 /** The name of the environment variable containing the files list for #snd_config_update. */
 #define ALSA_CONFIG_PATH_VAR "ALSA_CONFIG_PATH"
 
+/** The name of the environment variable containing the cache file for #snd_config_update. */
+#define ALSA_CONFIG_CACHE_VAR "ALSA_CONFIG_CACHE"
+
+/** The name of the environment variable enabling the watching of the files for #snd_config_update. */
+#define ALSA_CONFIG_INOTIFY_VAR "ALSA_CONFIG_INOTIFY"
+
+/** The name of the environment variable enabling the cache of expanded definitions. */
+#define ALSA_CONFIG_EXPAND_CACHE_VAR "ALSA_CONFIG_EXPAND_CACHE"
+
 /** The name of the default files used by #snd_config_update. */
 #define ALSA_CONFIG_PATH_DEFAULT ALSA_CONFIG_DIR "/alsa.conf"
 
@@ -3180,26 +3987,13 @@ int snd_config_search_alias_hooks(snd_config_t *config,
  * \warning Whenever the configuration tree is updated, all string
  * pointers and configuration node handles previously obtained from this
  * variable may become invalid.
+ * Use #snd_config_update_ref to keep the tree alive while it is used.
  *
  * \par Conforming to:
  * LSB 3.2
  */
 snd_config_t *snd_config = NULL;
 
-#ifndef DOC_HIDDEN
-struct finfo {
-	char *name;
-	dev_t dev;
-	ino_t ino;
-	time_t mtime;
-};
-
-struct _snd_config_update {
-	unsigned int count;
-	struct finfo *finfo;
-};
-#endif /* DOC_HIDDEN */
-
 static snd_config_update_t *snd_config_global_update = NULL;
 
 static int snd_config_hooks_call(snd_config_t *root, snd_config_t *config, snd_config_t *private_data)
@@ -3300,7 +4094,8 @@ static int snd_config_hooks(snd_config_t *config, snd_config_t *private_data)
 	snd_config_iterator_t i, next;
 	int err, hit, idx = 0;
 
-	if ((err = snd_config_search(config, "@hooks", &n)) < 0)
+	/* pending card configurations do not define hooks */
+	if ((err = snd_config_lookup(config, "@hooks", -1, &n)) < 0)
 		return 0;
 	snd_config_remove(n);
 	do {
@@ -3439,77 +4234,1144 @@ int snd_config_hook_load(snd_config_t *root, snd_config_t *config, snd_config_t
 	snd_config_delete(n);
 	return err;
 }
-#ifndef DOC_HIDDEN
-SND_DLSYM_BUILD_VERSION(snd_config_hook_load, SND_CONFIG_DLSYM_VERSION_HOOK);
+#ifndef DOC_HIDDEN
+SND_DLSYM_BUILD_VERSION(snd_config_hook_load, SND_CONFIG_DLSYM_VERSION_HOOK);
+#endif
+
+#ifndef DOC_HIDDEN
+int snd_determine_driver(int card, char **driver);
+#endif
+
+static struct snd_config_lazy *snd_config_lazy_find(snd_config_t *config,
+						    const char *id, size_t len)
+{
+	struct snd_config_lazy *lazy;
+	for (lazy = config->u.compound.lazy; lazy; lazy = lazy->next) {
+		if (strncmp(lazy->driver, id, len) == 0 && lazy->driver[len] == '\0')
+			return lazy;
+	}
+	return NULL;
+}
+
+static void snd_config_lazy_free(snd_config_t *config)
+{
+	struct snd_config_lazy *lazy, *next;
+	for (lazy = config->u.compound.lazy; lazy; lazy = next) {
+		next = lazy->next;
+		snd_config_delete(lazy->hook);
+		free(lazy->driver);
+		free(lazy);
+	}
+	config->u.compound.lazy = NULL;
+}
+
+static int snd_config_load_card(snd_config_t *root, snd_config_t *config,
+				const char *driver)
+{
+	snd_config_t *n, *private_data;
+	int err;
+
+	err = snd_config_imake_string(&private_data, "string", driver);
+	if (err < 0)
+		return err;
+	err = snd_config_hook_load(root, config, &n, private_data);
+	snd_config_delete(private_data);
+	return err;
+}
+
+static int snd_config_lazy_load1(snd_config_t *config, struct snd_config_lazy *lazy)
+{
+	struct snd_config_lazy **p;
+	int err;
+
+	/* unlink first, the hooks of the card may search this compound */
+	for (p = &config->u.compound.lazy; *p != lazy; p = &(*p)->next)
+		;
+	*p = lazy->next;
+	err = snd_config_load_card(config, lazy->hook, lazy->driver);
+	snd_config_delete(lazy->hook);
+	free(lazy->driver);
+	free(lazy);
+	return err;
+}
+
+/*
+ * Loads the deferred card configuration of the driver id.  Any other id
+ * (pcm, ctl, ...) may be defined by the files of every card, they are
+ * all loaded then.  Returns 1 if something was loaded.
+ */
+static int snd_config_lazy_load(snd_config_t *config, const char *id, size_t len)
+{
+	struct snd_config_lazy *lazy;
+	int err;
+
+	lazy = id ? snd_config_lazy_find(config, id, len) : NULL;
+	if (lazy) {
+		err = snd_config_lazy_load1(config, lazy);
+		return err < 0 ? err : 1;
+	}
+	if (!config->u.compound.lazy)
+		return 0;
+	while (config->u.compound.lazy) {
+		err = snd_config_lazy_load1(config, config->u.compound.lazy);
+		if (err < 0)
+			return err;
+	}
+	return 1;
+}
+
+static int snd_config_lazy_add(snd_config_t *config, snd_config_t *hook,
+			       const char *driver)
+{
+	struct snd_config_lazy *lazy, **p;
+	int err;
+
+	lazy = calloc(1, sizeof(*lazy));
+	if (!lazy)
+		return -ENOMEM;
+	lazy->driver = strdup(driver);
+	if (!lazy->driver) {
+		free(lazy);
+		return -ENOMEM;
+	}
+	err = snd_config_copy(&lazy->hook, hook);
+	if (err < 0) {
+		free(lazy->driver);
+		free(lazy);
+		return err;
+	}
+	/* keep the card order */
+	for (p = &config->u.compound.lazy; *p; p = &(*p)->next)
+		;
+	*p = lazy;
+	return 0;
+}
+
+/**
+ * \brief Loads and parses the given configurations files for each
+ *        installed sound card.
+ * \param[in] root Handle to the root configuration node.
+ * \param[in] config Handle to the configuration node for this hook.
+ * \param[out] dst The function puts the handle to the configuration
+ *                 node loaded from the file(s) at the address specified
+ *                 by \a dst.
+ * \param[in] private_data Handle to the private data configuration node.
+ * \return Zero if successful, otherwise a negative error code.
+ *
+ * This function works like #snd_config_hook_load, but the files are
+ * loaded once for each sound card.  The driver name is available with
+ * the \c private_string function to customize the file name.
+ *
+ * The files are not loaded immediately: the function only records the
+ * drivers of the installed cards.  The files of a driver are loaded
+ * when its node in \a root is searched for the first time, the files
+ * of all cards when any other node of \a root is searched or \a root
+ * is iterated.
+ */
+int snd_config_hook_load_for_all_cards(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data ATTRIBUTE_UNUSED)
+{
+	int card = -1, err;
+	
+	do {
+		err = snd_card_next(&card);
+		if (err < 0)
+			return err;
+		if (card >= 0) {
+			snd_config_t *n;
+			const char *driver;
+			char *fdriver = NULL;
+			err = snd_determine_driver(card, &fdriver);
+			if (err < 0)
+				return err;
+			/* another card with the same driver */
+			if (snd_config_lazy_find(root, fdriver, strlen(fdriver)))
+				goto __err;
+			if (snd_config_lookup(root, fdriver, -1, &n) >= 0) {
+				if (snd_config_get_string(n, &driver) < 0)
+					goto __err;
+				assert(driver);
+				while (1) {
+					char *s = strchr(driver, '.');
+					if (s == NULL)
+						break;
+					driver = s + 1;
+				}
+				if (snd_config_lazy_find(root, driver, strlen(driver)) ||
+				    snd_config_lookup(root, driver, -1, &n) >= 0)
+					goto __err;
+			} else {
+				driver = fdriver;
+			}
+			err = snd_config_lazy_add(root, config, driver);
+		      __err:
+			free(fdriver);
+			if (err < 0)
+				return err;
+		}
+	} while (card >= 0);
+	*dst = NULL;
+	return 0;
+}
+#ifndef DOC_HIDDEN
+SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VERSION_HOOK);
+#endif
+
+#ifndef DOC_HIDDEN
+
+/*
+ * Binary cache of the parsed configuration files
+ *
+ * The cache holds the tree obtained by parsing the files of
+ * snd_config_update_r() (including <file> includes) into an empty top
+ * node, i.e. the state before the hooks are executed.  The hooks are
+ * always run on the loaded tree, because their results depend on other
+ * files and on the present cards.
+ *
+ * Layout (native byte order, the magic and the ABI field of the header
+ * reject caches written by other architectures):
+ *   header
+ *   dependency records (top-level files first, then included files)
+ *   node records in pre-order, starting with the top node
+ */
+
+#define SND_CONFIG_CACHE_MAGIC		0x41434643	/* "CFCA" */
+#define SND_CONFIG_CACHE_VERSION	1
+#define SND_CONFIG_CACHE_ABI		(sizeof(long) | (sizeof(double) << 8))
+#define SND_CONFIG_CACHE_NOID		0xffffffffU
+#define SND_CONFIG_CACHE_COMPOUND	0xff	/* node tag of compounds */
+
+struct snd_config_cache_header {
+	u_int32_t magic;
+	u_int32_t version;
+	u_int32_t abi;
+	u_int32_t files;	/* top-level files */
+	u_int32_t deps;		/* top-level and included files */
+	u_int32_t reserved;
+	u_int64_t size;		/* size of the whole cache file */
+};
+
+struct snd_config_cache_dep {
+	u_int64_t dev;
+	u_int64_t ino;
+	int64_t mtime;
+	u_int32_t namelen;	/* followed by the name, no terminator */
+	u_int32_t reserved;
+};
+
+struct snd_config_cache_buf {
+	char *buf;
+	size_t len, alloc;
+};
+
+struct snd_config_cache_cursor {
+	const char *ptr, *end;
+	struct snd_config_arena *arena;
+};
+#endif /* DOC_HIDDEN */
+
+static int snd_config_update_add(snd_config_update_t *update, const char *name)
+{
+	struct stat st;
+	struct finfo *finfo;
+	char *str;
+
+	if (stat(name, &st) < 0)
+		return -errno;
+	str = strdup(name);
+	if (!str)
+		return -ENOMEM;
+	finfo = realloc(update->finfo, (update->count + 1) * sizeof(*finfo));
+	if (!finfo) {
+		free(str);
+		return -ENOMEM;
+	}
+	update->finfo = finfo;
+	finfo += update->count++;
+	finfo->name = str;
+	finfo->dev = st.st_dev;
+	finfo->ino = st.st_ino;
+	finfo->mtime = st.st_mtime;
+	return 0;
+}
+
+static int cache_put(struct snd_config_cache_buf *b, const void *data, size_t len)
+{
+	if (b->len + len > b->alloc) {
+		size_t alloc = b->alloc ? b->alloc : 64 * 1024;
+		char *buf;
+		while (alloc < b->len + len)
+			alloc *= 2;
+		buf = realloc(b->buf, alloc);
+		if (!buf)
+			return -ENOMEM;
+		b->buf = buf;
+		b->alloc = alloc;
+	}
+	memcpy(b->buf + b->len, data, len);
+	b->len += len;
+	return 0;
+}
+
+static int cache_put_string(struct snd_config_cache_buf *b, const char *str)
+{
+	u_int32_t len = str ? strlen(str) : SND_CONFIG_CACHE_NOID;
+	int err = cache_put(b, &len, sizeof(len));
+	if (err < 0 || !str)
+		return err;
+	return cache_put(b, str, len);
+}
+
+static int cache_put_deps(struct snd_config_cache_buf *b, snd_config_update_t *update)
+{
+	unsigned int k;
+	int err;
+
+	for (k = 0; k < update->count; k++) {
+		struct finfo *f = &update->finfo[k];
+		struct snd_config_cache_dep dep;
+		memset(&dep, 0, sizeof(dep));
+		dep.dev = f->dev;
+		dep.ino = f->ino;
+		dep.mtime = f->mtime;
+		dep.namelen = strlen(f->name);
+		err = cache_put(b, &dep, sizeof(dep));
+		if (err < 0)
+			return err;
+		err = cache_put(b, f->name, dep.namelen);
+		if (err < 0)
+			return err;
+	}
+	return 0;
+}
+
+static int cache_put_node(struct snd_config_cache_buf *b, snd_config_t *n)
+{
+	unsigned char tag[2];
+	int err;
+
+	if (n->type == SND_CONFIG_TYPE_COMPOUND) {
+		tag[0] = SND_CONFIG_CACHE_COMPOUND;
+		tag[1] = n->u.compound.join;
+	} else {
+		tag[0] = n->type;
+		tag[1] = 0;
+	}
+	err = cache_put(b, tag, sizeof(tag));
+	if (err < 0)
+		return err;
+	err = cache_put_string(b, n->id);
+	if (err < 0)
+		return err;
+	switch (n->type) {
+	case SND_CONFIG_TYPE_INTEGER:
+		return cache_put(b, &n->u.integer, sizeof(n->u.integer));
+	case SND_CONFIG_TYPE_INTEGER64:
+		return cache_put(b, &n->u.integer64, sizeof(n->u.integer64));
+	case SND_CONFIG_TYPE_REAL:
+		return cache_put(b, &n->u.real, sizeof(n->u.real));
+	case SND_CONFIG_TYPE_STRING:
+		return cache_put_string(b, n->u.string);
+	case SND_CONFIG_TYPE_COMPOUND:
+	{
+		snd_config_iterator_t i, next;
+		u_int32_t count = 0;
+		snd_config_for_each(i, next, n)
+			count++;
+		err = cache_put(b, &count, sizeof(count));
+		if (err < 0)
+			return err;
+		snd_config_for_each(i, next, n) {
+			err = cache_put_node(b, snd_config_iterator_entry(i));
+			if (err < 0)
+				return err;
+		}
+		return 0;
+	}
+	default:
+		/* pointers cannot be stored */
+		return -EINVAL;
+	}
+}
+
+/* write the cache to a temporary file and rename it, so that readers
+ * never see a partially written cache
+ */
+static int snd_config_cache_save(const char *path, snd_config_t *top,
+				 snd_config_update_t *files,
+				 snd_config_update_t *includes)
+{
+	struct snd_config_cache_buf b;
+	struct snd_config_cache_header *hdr;
+	struct snd_config_cache_header h;
+	char *tmp;
+	size_t pos;
+	ssize_t res;
+	int fd, err;
+
+	memset(&b, 0, sizeof(b));
+	memset(&h, 0, sizeof(h));
+	h.magic = SND_CONFIG_CACHE_MAGIC;
+	h.version = SND_CONFIG_CACHE_VERSION;
+	h.abi = SND_CONFIG_CACHE_ABI;
+	h.files = files->count;
+	h.deps = files->count + includes->count;
+	err = cache_put(&b, &h, sizeof(h));
+	if (err >= 0)
+		err = cache_put_deps(&b, files);
+	if (err >= 0)
+		err = cache_put_deps(&b, includes);
+	if (err >= 0)
+		err = cache_put_node(&b, top);
+	if (err < 0)
+		goto _end;
+	hdr = (struct snd_config_cache_header *)b.buf;
+	hdr->size = b.len;
+	tmp = malloc(strlen(path) + 8);
+	if (!tmp) {
+		err = -ENOMEM;
+		goto _end;
+	}
+	sprintf(tmp, "%s.XXXXXX", path);
+	fd = mkstemp(tmp);
+	if (fd < 0) {
+		err = -errno;
+		free(tmp);
+		goto _end;
+	}
+	fchmod(fd, 0644);
+	for (pos = 0; pos < b.len; pos += res) {
+		res = write(fd, b.buf + pos, b.len - pos);
+		if (res < 0) {
+			if (errno == EINTR) {
+				res = 0;
+				continue;
+			}
+			err = -errno;
+			break;
+		}
+	}
+	if (close(fd) < 0 && err >= 0)
+		err = -errno;
+	if (err >= 0 && rename(tmp, path) < 0)
+		err = -errno;
+	if (err < 0)
+		unlink(tmp);
+	free(tmp);
+ _end:
+	free(b.buf);
+	return err;
+}
+
+static const void *cache_get(struct snd_config_cache_cursor *c, size_t len)
+{
+	const char *ptr = c->ptr;
+	if ((size_t)(c->end - ptr) < len)
+		return NULL;
+	c->ptr += len;
+	return ptr;
+}
+
+static int cache_get_string(struct snd_config_cache_cursor *c, char **str)
+{
+	const void *ptr;
+	u_int32_t len;
+
+	ptr = cache_get(c, sizeof(len));
+	if (!ptr)
+		return -EINVAL;
+	memcpy(&len, ptr, sizeof(len));
+	if (len == SND_CONFIG_CACHE_NOID) {
+		*str = NULL;
+		return 0;
+	}
+	ptr = cache_get(c, len);
+	if (!ptr)
+		return -EINVAL;
+	*str = snd_config_arena_alloc(c->arena, len + 1);
+	if (!*str)
+		return -ENOMEM;
+	memcpy(*str, ptr, len);
+	(*str)[len] = '\0';
+	return 0;
+}
+
+static int cache_get_node(struct snd_config_cache_cursor *c, snd_config_t *parent,
+			  snd_config_t **config)
+{
+	const unsigned char *tag;
+	const void *ptr;
+	snd_config_type_t type;
+	snd_config_t *n;
+	char *id;
+	int err;
+
+	tag = cache_get(c, 2);
+	if (!tag)
+		return -EINVAL;
+	switch (tag[0]) {
+	case SND_CONFIG_TYPE_INTEGER:
+	case SND_CONFIG_TYPE_INTEGER64:
+	case SND_CONFIG_TYPE_REAL:
+	case SND_CONFIG_TYPE_STRING:
+		type = tag[0];
+		break;
+	case SND_CONFIG_CACHE_COMPOUND:
+		type = SND_CONFIG_TYPE_COMPOUND;
+		break;
+	default:
+		return -EINVAL;
+	}
+	err = cache_get_string(c, &id);
+	if (err < 0)
+		return err;
+	if (parent && !id)
+		return -EINVAL;
+	if (parent)
+		err = _snd_config_make_add(&n, &id, type, parent, c->arena);
+	else
+		err = _snd_config_make(&n, &id, type, c->arena);
+	if (err < 0)
+		return err;
+	*config = n;
+	switch (n->type) {
+	case SND_CONFIG_TYPE_INTEGER:
+		ptr = cache_get(c, sizeof(n->u.integer));
+		if (!ptr)
+			return -EINVAL;
+		memcpy(&n->u.integer, ptr, sizeof(n->u.integer));
+		return 0;
+	case SND_CONFIG_TYPE_INTEGER64:
+		ptr = cache_get(c, sizeof(n->u.integer64));
+		if (!ptr)
+			return -EINVAL;
+		memcpy(&n->u.integer64, ptr, sizeof(n->u.integer64));
+		return 0;
+	case SND_CONFIG_TYPE_REAL:
+		ptr = cache_get(c, sizeof(n->u.real));
+		if (!ptr)
+			return -EINVAL;
+		memcpy(&n->u.real, ptr, sizeof(n->u.real));
+		return 0;
+	case SND_CONFIG_TYPE_STRING:
+		err = cache_get_string(c, &n->u.string);
+		if (n->u.string)
+			n->flags |= SND_CONFIG_ARENA_STRING;
+		return err;
+	default:
+	{
+		snd_config_t *child;
+		u_int32_t count;
+		n->u.compound.join = tag[1];
+		ptr = cache_get(c, sizeof(count));
+		if (!ptr)
+			return -EINVAL;
+		memcpy(&count, ptr, sizeof(count));
+		while (count-- > 0) {
+			err = cache_get_node(c, n, &child);
+			if (err < 0)
+				return err;
+		}
+		return 0;
+	}
+	}
+}
+
+/* check one dependency record, returns 1 if it is still valid */
+static int cache_check_dep(struct snd_config_cache_cursor *c, const struct finfo *f)
+{
+	struct snd_config_cache_dep dep;
+	struct stat st;
+	const void *ptr;
+	const char *name;
+
+	ptr = cache_get(c, sizeof(dep));
+	if (!ptr)
+		return 0;
+	memcpy(&dep, ptr, sizeof(dep));
+	if (dep.namelen >= PATH_MAX)
+		return 0;
+	name = cache_get(c, dep.namelen);
+	if (!name)
+		return 0;
+	if (f) {
+		/* top-level file, already checked by the caller */
+		return strlen(f->name) == dep.namelen &&
+		       !memcmp(f->name, name, dep.namelen) &&
+		       dep.dev == (u_int64_t)f->dev &&
+		       dep.ino == (u_int64_t)f->ino &&
+		       dep.mtime == (int64_t)f->mtime;
+	} else {
+		char path[PATH_MAX];
+		memcpy(path, name, dep.namelen);
+		path[dep.namelen] = '\0';
+		return stat(path, &st) >= 0 &&
+		       dep.dev == (u_int64_t)st.st_dev &&
+		       dep.ino == (u_int64_t)st.st_ino &&
+		       dep.mtime == (int64_t)st.st_mtime;
+	}
+}
+
+/* returns 1 and the loaded tree if the cache is valid for the given
+ * files, 0 if the files must be parsed
+ */
+static int snd_config_cache_load(const char *path, snd_config_update_t *files,
+				 snd_config_t **top)
+{
+	struct snd_config_cache_cursor c;
+	struct snd_config_cache_header h;
+	struct stat st;
+	snd_config_t *n = NULL;
+	void *map;
+	unsigned int k;
+	int fd, err = 0;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+	if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(h)) {
+		close(fd);
+		return 0;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (map == MAP_FAILED)
+		return 0;
+	memcpy(&h, map, sizeof(h));
+	if (h.magic != SND_CONFIG_CACHE_MAGIC ||
+	    h.version != SND_CONFIG_CACHE_VERSION ||
+	    h.abi != SND_CONFIG_CACHE_ABI ||
+	    h.size != (u_int64_t)st.st_size ||
+	    h.files != files->count || h.deps < h.files)
+		goto _end;
+	c.ptr = (const char *)map + sizeof(h);
+	c.end = (const char *)map + st.st_size;
+	for (k = 0; k < h.deps; k++) {
+		if (!cache_check_dep(&c, k < h.files ? &files->finfo[k] : NULL))
+			goto _end;
+	}
+	c.arena = snd_config_arena_new();
+	if (!c.arena) {
+		err = -ENOMEM;
+		goto _end;
+	}
+	err = cache_get_node(&c, NULL, &n);
+	snd_config_arena_put(c.arena);
+	if (err >= 0 && (n->type != SND_CONFIG_TYPE_COMPOUND || c.ptr != c.end))
+		err = -EINVAL;
+	if (err < 0) {
+		if (n)
+			snd_config_delete(n);
+		if (err != -ENOMEM)
+			err = 0;
+		goto _end;
+	}
+	*top = n;
+	err = 1;
+ _end:
+	munmap(map, st.st_size);
+	return err;
+}
+
+#ifndef DOC_HIDDEN
+/*
+ * Definitions expanded from the global configuration by
+ * snd_config_search_definition() are remembered when the environment
+ * variable ALSA_CONFIG_EXPAND_CACHE is set, so later lookups of the
+ * same name and arguments skip the expansion and the evaluation of
+ * functions.  Only the tree published by snd_config_update_global()
+ * is memoized.  The entries are dropped when the global configuration
+ * is reread or freed; the generation tells expansions which were
+ * running at that time not to store their results.
+ */
+struct snd_config_memo {
+	struct list_head list;
+	char *base;
+	char *name;
+	snd_config_t *config;
+};
+
+#define SND_CONFIG_MEMO_MAX	64
+#endif /* DOC_HIDDEN */
+
+static LIST_HEAD(snd_config_memo_list);
+static unsigned int snd_config_memo_count;
+static unsigned int snd_config_generation;
+static snd_config_t *snd_config_memo_root;	/* the memoized tree */
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t snd_config_memo_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static inline void snd_config_memo_lock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&snd_config_memo_mutex);
+#endif
+}
+
+static inline void snd_config_memo_unlock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&snd_config_memo_mutex);
+#endif
+}
+
+static void snd_config_memo_free(struct snd_config_memo *memo)
+{
+	list_del(&memo->list);
+	snd_config_memo_count--;
+	snd_config_delete(memo->config);
+	free(memo->base);
+	free(memo->name);
+	free(memo);
+}
+
+static void snd_config_memo_flush(void)
+{
+	snd_config_memo_lock();
+	snd_config_generation++;
+	snd_config_memo_root = NULL;
+	while (!list_empty(&snd_config_memo_list))
+		snd_config_memo_free(list_entry(snd_config_memo_list.next,
+						struct snd_config_memo, list));
+	snd_config_memo_unlock();
+}
+
+static void snd_config_memo_publish(snd_config_t *root)
+{
+	snd_config_memo_lock();
+	snd_config_memo_root = root;
+	snd_config_memo_unlock();
+}
+
+static int snd_config_memo_match(struct snd_config_memo *memo,
+				 const char *base, const char *name)
+{
+	if (strcmp(memo->name, name) != 0)
+		return 0;
+	if (!memo->base || !base)
+		return memo->base == base;
+	return strcmp(memo->base, base) == 0;
+}
+
+/*
+ * Puts a copy of the remembered expansion to result and returns 1 if
+ * there is one.  Otherwise returns 0 and the current generation, or
+ * -ENOENT if root is not memoized.
+ */
+static int snd_config_memo_get(snd_config_t *root, const char *base, const char *name,
+			       snd_config_t **result, unsigned int *generation)
+{
+	struct list_head *pos;
+	int err = 0;
+
+	snd_config_memo_lock();
+	if (root != snd_config_memo_root) {
+		snd_config_memo_unlock();
+		return -ENOENT;
+	}
+	*generation = snd_config_generation;
+	list_for_each(pos, &snd_config_memo_list) {
+		struct snd_config_memo *memo = list_entry(pos, struct snd_config_memo, list);
+		if (snd_config_memo_match(memo, base, name)) {
+			/* keep the recently used entries at the front */
+			list_del(&memo->list);
+			list_add(&memo->list, &snd_config_memo_list);
+			err = snd_config_copy(result, memo->config);
+			if (err >= 0)
+				err = 1;
+			break;
+		}
+	}
+	snd_config_memo_unlock();
+	return err;
+}
+
+/* remembers a copy of config unless the generation has changed */
+static void snd_config_memo_put(const char *base, const char *name,
+				snd_config_t *config, unsigned int generation)
+{
+	struct snd_config_memo *memo;
+	struct list_head *pos;
+
+	memo = calloc(1, sizeof(*memo));
+	if (!memo)
+		return;
+	memo->name = strdup(name);
+	if (base)
+		memo->base = strdup(base);
+	if (!memo->name || (base && !memo->base) ||
+	    snd_config_copy(&memo->config, config) < 0) {
+		free(memo->base);
+		free(memo->name);
+		free(memo);
+		return;
+	}
+	snd_config_memo_lock();
+	if (generation != snd_config_generation)
+		goto _drop;
+	list_for_each(pos, &snd_config_memo_list) {
+		if (snd_config_memo_match(list_entry(pos, struct snd_config_memo, list),
+					  base, name))
+			goto _drop;
+	}
+	if (snd_config_memo_count >= SND_CONFIG_MEMO_MAX)
+		snd_config_memo_free(list_entry(snd_config_memo_list.prev,
+						struct snd_config_memo, list));
+	list_add(&memo->list, &snd_config_memo_list);
+	snd_config_memo_count++;
+	snd_config_memo_unlock();
+	return;
+ _drop:
+	snd_config_memo_unlock();
+	snd_config_delete(memo->config);
+	free(memo->base);
+	free(memo->name);
+	free(memo);
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+#define SND_CONFIG_WATCH_MASK	(IN_CLOSE_WRITE | IN_MODIFY | IN_ATTRIB | \
+				 IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO)
+
+/* watches the directory of the file name */
+static int snd_config_update_watch_dir(int fd, const char *name)
+{
+	const char *slash = strrchr(name, '/');
+	size_t len = slash ? (size_t)(slash - name) : 1;
+	char dir[len + 2];
+
+	if (slash) {
+		memcpy(dir, name, len);
+		if (!len)
+			dir[len++] = '/';
+	} else {
+		dir[0] = '.';
+	}
+	dir[len] = '\0';
+	return inotify_add_watch(fd, dir, SND_CONFIG_WATCH_MASK);
+}
+
+/*
+ * Watches the directories of the configuration files, which also
+ * reports files replaced by rename() or created later.  For a symlink,
+ * the directory of the resolved file is watched too, so edits of the
+ * target are seen.  The descriptor of the previous watch is reused if
+ * fd is not negative.  A failure only leaves the update without a watch.
+ */
+static void snd_config_update_watch(snd_config_update_t *update, const char *configs,
+				    int fd)
+{
+	unsigned int k;
+	size_t tlen = 0;
+	char *targets = NULL;
+
+	if (fd < 0)
+		fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return;
+	for (k = 0; k < update->count; k++) {
+		const char *name = update->finfo[k].name;
+		char *real;
+		if (snd_config_update_watch_dir(fd, name) < 0)
+			goto _err;
+		real = realpath(name, NULL);
+		if (!real || strcmp(real, name) == 0) {
+			free(real);
+			continue;
+		}
+		if (snd_config_update_watch_dir(fd, real) < 0) {
+			free(real);
+			goto _err;
+		}
+		{
+			size_t rlen = strlen(real);
+			char *t = realloc(targets, tlen + rlen + 2);
+			if (!t) {
+				free(real);
+				goto _err;
+			}
+			if (tlen)
+				t[tlen++] = ':';
+			memcpy(t + tlen, real, rlen + 1);
+			tlen += rlen;
+			targets = t;
+		}
+		free(real);
+	}
+	update->configs = strdup(configs);
+	if (!update->configs)
+		goto _err;
+	update->targets = targets;
+	update->notify_fd = fd;
+	update->notify_pid = getpid();
+	return;
+ _err:
+	free(targets);
+	close(fd);
+}
+
+/*
+ * Takes the descriptor out of the watch of an update.  A descriptor
+ * inherited over fork() shares its events with the parent, the child
+ * closes it and returns -1 to get a new one.
+ */
+static int snd_config_update_unwatch(snd_config_update_t *update)
+{
+	int fd = update->notify_fd;
+
+	if (!update->configs)
+		return -1;
+	free(update->configs);
+	free(update->targets);
+	update->configs = NULL;
+	update->targets = NULL;
+	update->notify_fd = -1;
+	if (update->notify_pid != getpid()) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/* checks whether name is the last component of a file in the list */
+static int snd_config_update_watched(const char *configs, const char *name)
+{
+	size_t l, nlen = strlen(name);
+	const char *c, *base;
+
+	for (c = configs; (l = strcspn(c, ": ")) > 0; ) {
+		for (base = c + l; base > c && base[-1] != '/'; base--)
+			;
+		if ((size_t)(c + l - base) == nlen && memcmp(base, name, nlen) == 0)
+			return 1;
+		c += l;
+		if (!*c)
+			break;
+		c++;
+	}
+	return 0;
+}
+
+/* drains the pending events and returns 1 if any of them concerns the files */
+static int snd_config_update_changed(snd_config_update_t *update)
+{
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t len;
+	char *p;
+	int changed = 0;
+
+	while ((len = read(update->notify_fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *)p;
+			if (ev->mask & (IN_Q_OVERFLOW | IN_IGNORED))
+				changed = 1;
+			else if (ev->len &&
+				 (snd_config_update_watched(update->configs, ev->name) ||
+				  (update->targets &&
+				   snd_config_update_watched(update->targets, ev->name))))
+				changed = 1;
+		}
+	}
+	if (len < 0 && errno != EAGAIN)
+		changed = 1;
+	return changed;
+}
+#endif /* HAVE_SYS_INOTIFY_H */
+
+/* returns the number of file names in a configuration path */
+static unsigned int snd_config_path_count(const char *configs)
+{
+	unsigned int k;
+	size_t l;
+
+	for (k = 0; (l = strcspn(configs, ": ")) > 0; ) {
+		configs += l;
+		k++;
+		if (!*configs)
+			break;
+		configs++;
+	}
+	return k;
+}
+
+#ifndef DOC_HIDDEN
+/*
+ * The global tree as seen by snd_config_update_ref().  As long as the
+ * snapshot shows that the files did not change, opens take a reference
+ * to its tree without the update mutex.  It has its own copy of the
+ * file list, the global update structure is replaced under the mutex.
+ */
+struct snd_config_snapshot {
+	snd_config_t *top;
+	char *configs;		/* the file list the tree was read from */
+	unsigned int count;
+	struct finfo *finfo;
+	int notify_fd;		/* inotify descriptor of the update, or -1 */
+	pid_t notify_pid;
+};
+#endif
+
+static struct snd_config_snapshot *snd_config_snapshot;
+
+/*
+ * The readers of the snapshot count themselves in the slot of the
+ * current epoch.  A replaced snapshot is freed after both slots drained
+ * once; the readers arriving meanwhile use the other slot and see the
+ * new snapshot, so the updater does not starve.
+ */
+static unsigned int snd_config_snapshot_epoch;
+static unsigned int snd_config_snapshot_readers[2];
+
+/* releases a reference to a tree, see snd_config_ref() */
+static void snd_config_put(snd_config_t *top)
+{
+	if (__atomic_fetch_sub(&top->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+		snd_config_delete(top);
+}
+
+static void snd_config_snapshot_free(struct snd_config_snapshot *snapshot)
+{
+	unsigned int k;
+
+	for (k = 0; k < snapshot->count; k++)
+		free(snapshot->finfo[k].name);
+	free(snapshot->finfo);
+	free(snapshot->configs);
+	free(snapshot);
+}
+
+/*
+ * Returns NULL if the tree cannot be checked without the lock, i.e.
+ * when a file of the list is missing and may appear later.
+ */
+static struct snd_config_snapshot *snd_config_snapshot_new(snd_config_t *top,
+							   snd_config_update_t *update,
+							   const char *configs)
+{
+	struct snd_config_snapshot *snapshot;
+	unsigned int k;
+
+	if (!top || !update || update->count != snd_config_path_count(configs))
+		return NULL;
+	snapshot = calloc(1, sizeof(*snapshot));
+	if (!snapshot)
+		return NULL;
+	snapshot->top = top;
+	snapshot->notify_fd = -1;
+	snapshot->configs = strdup(configs);
+	snapshot->finfo = calloc(update->count, sizeof(struct finfo));
+	if (!snapshot->configs || !snapshot->finfo)
+		goto _err;
+	for (k = 0; k < update->count; k++) {
+		snapshot->finfo[k] = update->finfo[k];
+		snapshot->finfo[k].name = strdup(update->finfo[k].name);
+		if (!snapshot->finfo[k].name)
+			goto _err;
+		snapshot->count++;
+	}
+#ifdef HAVE_SYS_INOTIFY_H
+	if (update->configs) {
+		snapshot->notify_fd = update->notify_fd;
+		snapshot->notify_pid = update->notify_pid;
+	}
 #endif
+	return snapshot;
 
-#ifndef DOC_HIDDEN
-int snd_determine_driver(int card, char **driver);
+ _err:
+	snd_config_snapshot_free(snapshot);
+	return NULL;
+}
+
+/*
+ * Replaces the published snapshot, called with the update mutex held.
+ * The tree of the old snapshot keeps its owner reference.
+ */
+static void snd_config_snapshot_publish(struct snd_config_snapshot *snapshot)
+{
+	struct snd_config_snapshot *old;
+	unsigned int k, epoch;
+
+	old = __atomic_exchange_n(&snd_config_snapshot, snapshot, __ATOMIC_SEQ_CST);
+	if (!old)
+		return;
+	for (k = 0; k < 2; k++) {
+		epoch = __atomic_fetch_add(&snd_config_snapshot_epoch, 1, __ATOMIC_SEQ_CST);
+		while (__atomic_load_n(&snd_config_snapshot_readers[epoch & 1], __ATOMIC_ACQUIRE))
+			sched_yield();
+	}
+	snd_config_snapshot_free(old);
+}
+
+/* the check of snd_config_update_r() without touching the update */
+static int snd_config_snapshot_current(const struct snd_config_snapshot *snapshot,
+				       const char *configs)
+{
+	unsigned int k;
+	struct stat st;
+
+	if (strcmp(snapshot->configs, configs) != 0)
+		return 0;
+#ifdef HAVE_SYS_INOTIFY_H
+	if (snapshot->notify_fd >= 0 && snapshot->notify_pid == getpid()) {
+		int len;
+		/* the events are consumed by the locked update */
+		return ioctl(snapshot->notify_fd, FIONREAD, &len) == 0 && len == 0;
+	}
 #endif
+	for (k = 0; k < snapshot->count; k++) {
+		const struct finfo *f = &snapshot->finfo[k];
+		if (stat(f->name, &st) < 0 ||
+		    st.st_dev != f->dev ||
+		    st.st_ino != f->ino ||
+		    st.st_mtime != f->mtime)
+			return 0;
+	}
+	return 1;
+}
 
-/**
- * \brief Loads and parses the given configurations files for each
- *        installed sound card.
- * \param[in] root Handle to the root configuration node.
- * \param[in] config Handle to the configuration node for this hook.
- * \param[out] dst The function puts the handle to the configuration
- *                 node loaded from the file(s) at the address specified
- *                 by \a dst.
- * \param[in] private_data Handle to the private data configuration node.
- * \return Zero if successful, otherwise a negative error code.
- *
- * This function works like #snd_config_hook_load, but the files are
- * loaded once for each sound card.  The driver name is available with
- * the \c private_string function to customize the file name.
+/*
+ * Checks the published snapshot without the update mutex and, if it is
+ * current, takes a reference to its tree when top is not NULL.
  */
-int snd_config_hook_load_for_all_cards(snd_config_t *root, snd_config_t *config, snd_config_t **dst, snd_config_t *private_data ATTRIBUTE_UNUSED)
+static int snd_config_snapshot_get(snd_config_t **top)
 {
-	int card = -1, err;
-	
-	do {
-		err = snd_card_next(&card);
-		if (err < 0)
-			return err;
-		if (card >= 0) {
-			snd_config_t *n, *private_data = NULL;
-			const char *driver;
-			char *fdriver = NULL;
-			err = snd_determine_driver(card, &fdriver);
-			if (err < 0)
-				return err;
-			if (snd_config_search(root, fdriver, &n) >= 0) {
-				if (snd_config_get_string(n, &driver) < 0)
-					goto __err;
-				assert(driver);
-				while (1) {
-					char *s = strchr(driver, '.');
-					if (s == NULL)
-						break;
-					driver = s + 1;
-				}
-				if (snd_config_search(root, driver, &n) >= 0)
-					goto __err;
-			} else {
-				driver = fdriver;
-			}
-			err = snd_config_imake_string(&private_data, "string", driver);
-			if (err < 0)
-				goto __err;
-			err = snd_config_hook_load(root, config, &n, private_data);
-		      __err:
-			if (private_data)
-				snd_config_delete(private_data);
-			free(fdriver);
-			if (err < 0)
-				return err;
+	struct snd_config_snapshot *snapshot;
+	const char *configs;
+	unsigned int slot;
+	int current = 0;
+
+	configs = getenv(ALSA_CONFIG_PATH_VAR);
+	if (!configs || !*configs)
+		configs = ALSA_CONFIG_PATH_DEFAULT;
+	slot = __atomic_load_n(&snd_config_snapshot_epoch, __ATOMIC_SEQ_CST) & 1;
+	__atomic_add_fetch(&snd_config_snapshot_readers[slot], 1, __ATOMIC_SEQ_CST);
+	snapshot = __atomic_load_n(&snd_config_snapshot, __ATOMIC_SEQ_CST);
+	if (snapshot && snd_config_snapshot_current(snapshot, configs)) {
+		if (top) {
+			__atomic_add_fetch(&snapshot->top->refcount, 1, __ATOMIC_RELAXED);
+			*top = snapshot->top;
 		}
-	} while (card >= 0);
-	*dst = NULL;
-	return 0;
+		current = 1;
+	}
+	__atomic_sub_fetch(&snd_config_snapshot_readers[slot], 1, __ATOMIC_RELEASE);
+	return current;
+}
+
+/*
+ * Releases a tree replaced by snd_config_update_r(); the global one may
+ * still be referenced by the readers of the snapshot.
+ */
+static void snd_config_update_drop(snd_config_t **_top, snd_config_t *top)
+{
+	if (_top != &snd_config) {
+		snd_config_delete(top);
+		return;
+	}
+	snd_config_memo_flush();
+	snd_config_snapshot_publish(NULL);
+	snd_config_put(top);
 }
-#ifndef DOC_HIDDEN
-SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VERSION_HOOK);
-#endif
 
 /** 
  * \brief Updates a configuration tree by rereading the configuration files (if needed).
@@ -3530,6 +5392,17 @@ SND_DLSYM_BUILD_VERSION(snd_config_hook_load_for_all_cards, SND_CONFIG_DLSYM_VER
  * The global configuration files are specified in the environment variable
  * \c ALSA_CONFIG_PATH.
  *
+ * If the environment variable \c ALSA_CONFIG_INOTIFY is set to a value
+ * other than \c 0, the directories of the configuration files are
+ * watched with inotify, and as long as no file of the list was touched,
+ * the check for changes does not need to stat the files.
+ *
+ * If the environment variable \c ALSA_CONFIG_CACHE contains a file name,
+ * the parsed contents of the configuration files are stored in this file
+ * and loaded from it as long as none of the configuration files (and the
+ * files they include) were modified.  The hooks are executed in either
+ * case.
+ *
  * \warning If the configuration tree is reread, all string pointers and
  * configuration node handles previously obtained from this tree become
  * invalid.
@@ -3546,7 +5419,12 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 	size_t l;
 	snd_config_update_t *local;
 	snd_config_update_t *update;
+	snd_config_update_t *includes = NULL;
 	snd_config_t *top;
+	const char *cache;
+#ifdef HAVE_SYS_INOTIFY_H
+	const char *notify;
+#endif
 	
 	assert(_top && _update);
 	top = *_top;
@@ -3557,13 +5435,13 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		if (!configs || !*configs)
 			configs = ALSA_CONFIG_PATH_DEFAULT;
 	}
-	for (k = 0, c = configs; (l = strcspn(c, ": ")) > 0; ) {
-		c += l;
-		k++;
-		if (!*c)
-			break;
-		c++;
-	}
+#ifdef HAVE_SYS_INOTIFY_H
+	if (update && update->configs && update->notify_pid == getpid() &&
+	    strcmp(update->configs, configs) == 0 &&
+	    !snd_config_update_changed(update))
+		return 0;
+#endif
+	k = snd_config_path_count(configs);
 	if (k == 0) {
 		local = NULL;
 		goto _reread;
@@ -3590,6 +5468,13 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 			break;
 		c++;
 	}
+#ifdef HAVE_SYS_INOTIFY_H
+	/* before the files are checked, so that no change is missed */
+	notify = getenv(ALSA_CONFIG_INOTIFY_VAR);
+	if (notify && *notify && strcmp(notify, "0") != 0)
+		snd_config_update_watch(local, configs,
+					update ? snd_config_update_unwatch(update) : -1);
+#endif
 	for (k = 0; k < local->count; ++k) {
 		struct stat st;
 		struct finfo *lf = &local->finfo[k];
@@ -3618,12 +5503,26 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		    lf->mtime != uf->mtime)
 			goto _reread;
 	}
+#ifdef HAVE_SYS_INOTIFY_H
+	if (local->configs) {
+		/* keep the new watch, local takes the old one (if any) */
+		char *configs1 = update->configs;
+		char *targets1 = update->targets;
+		int fd = update->notify_fd;
+		update->configs = local->configs;
+		update->targets = local->targets;
+		update->notify_fd = local->notify_fd;
+		local->configs = configs1;
+		local->targets = targets1;
+		local->notify_fd = fd;
+	}
+#endif
 	err = 0;
 
  _end:
 	if (err < 0) {
 		if (top) {
-			snd_config_delete(top);
+			snd_config_update_drop(_top, top);
 			*_top = NULL;
 		}
 		if (update) {
@@ -3633,20 +5532,31 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 	}
 	if (local)
 		snd_config_update_free(local);
+	if (includes)
+		snd_config_update_free(includes);
 	return err;
 
  _reread:
  	*_top = NULL;
  	*_update = NULL;
+	if (top) {
+		snd_config_update_drop(_top, top);
+		top = NULL;
+	}
  	if (update) {
  		snd_config_update_free(update);
  		update = NULL;
  	}
-	if (top) {
-		snd_config_delete(top);
-		top = NULL;
+	cache = local ? getenv(ALSA_CONFIG_CACHE_VAR) : NULL;
+	if (cache && *cache) {
+		err = snd_config_cache_load(cache, local, &top);
+		if (err < 0)
+			goto _end;
+		if (err > 0)
+			goto _skip;
+		includes = calloc(1, sizeof(*includes));
 	}
-	err = snd_config_top(&top);
+	err = snd_config_top_arena(&top);
 	if (err < 0)
 		goto _end;
 	if (!local)
@@ -3655,7 +5565,7 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 		snd_input_t *in;
 		err = snd_input_stdio_open(&in, local->finfo[k].name, "r");
 		if (err >= 0) {
-			err = snd_config_load(top, in);
+			err = snd_config_load1(top, in, 0, includes);
 			snd_input_close(in);
 			if (err < 0) {
 				SNDERR("%s may be old or corrupted: consider to remove or fix it", local->finfo[k].name);
@@ -3665,6 +5575,13 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 			SNDERR("cannot access file %s", local->finfo[k].name);
 		}
 	}
+	if (includes) {
+		/* the cache is only an optimization, ignore errors */
+		if (!includes->incomplete)
+			snd_config_cache_save(cache, top, local, includes);
+		snd_config_update_free(includes);
+		includes = NULL;
+	}
  _skip:
 	err = snd_config_hooks(top, NULL);
 	if (err < 0) {
@@ -3680,6 +5597,51 @@ int snd_config_update_r(snd_config_t **_top, snd_config_update_t **_update, cons
 static pthread_mutex_t snd_config_update_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
+static inline void snd_config_lock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&snd_config_update_mutex);
+#endif
+}
+
+static inline void snd_config_unlock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&snd_config_update_mutex);
+#endif
+}
+
+/* called with the lock held */
+static int snd_config_update_global(void)
+{
+	struct snd_config_snapshot *snapshot;
+	snd_config_update_t *update;
+	const char *configs;
+	int err;
+
+	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
+	if (err < 0)
+		return err;
+	if (err > 0) {
+		/* the tree is shared by all threads from now on */
+		snd_config_share(snd_config);
+		snd_config_memo_publish(snd_config);
+	}
+	/* republish when the tree or the watch changed */
+	snapshot = __atomic_load_n(&snd_config_snapshot, __ATOMIC_RELAXED);
+	update = snd_config_global_update;
+	if (err == 0 && snapshot &&
+	    (!update || !update->configs ||
+	     (snapshot->notify_fd == update->notify_fd &&
+	      snapshot->notify_pid == update->notify_pid)))
+		return 0;
+	configs = getenv(ALSA_CONFIG_PATH_VAR);
+	if (!configs || !*configs)
+		configs = ALSA_CONFIG_PATH_DEFAULT;
+	snd_config_snapshot_publish(snd_config_snapshot_new(snd_config, update, configs));
+	return err;
+}
+
 /** 
  * \brief Updates #snd_config by rereading the global configuration files (if needed).
  * \return 0 if #snd_config was up to date, 1 if #snd_config was
@@ -3687,7 +5649,8 @@ static pthread_mutex_t snd_config_update_mutex = PTHREAD_MUTEX_INITIALIZER;
  *
  * \warning Whenever #snd_config is updated, all string pointers and
  * configuration node handles previously obtained from it may become
- * invalid.
+ * invalid, unless a reference to the tree was obtained with
+ * #snd_config_update_ref.
  *
  * \par Errors:
  * Any errors encountered when parsing the input or returned by hooks or
@@ -3700,16 +5663,84 @@ int snd_config_update(void)
 {
 	int err;
 
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_lock(&snd_config_update_mutex);
-#endif
-	err = snd_config_update_r(&snd_config, &snd_config_global_update, NULL);
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_unlock(&snd_config_update_mutex);
-#endif
+	if (snd_config_snapshot_get(NULL))
+		return 0;
+	snd_config_lock();
+	err = snd_config_update_global();
+	snd_config_unlock();
+	return err;
+}
+
+/**
+ * \brief Updates #snd_config and takes a reference to it.
+ * \param[out] top The function puts the handle to the current global
+ *                 configuration tree at the address specified by \a top.
+ * \return 0 if #snd_config was up to date, 1 if #snd_config was
+ *         updated, otherwise a negative error code.
+ *
+ * Like #snd_config_update, but the returned tree stays valid until it
+ * is released with #snd_config_unref, even if #snd_config is reread
+ * or freed in the meantime.  The tree must not be modified; searches
+ * and iterations in it are safe from several threads.  The hooks and
+ * card configurations which they process on demand are serialized
+ * internally.
+ *
+ * As long as the configuration files did not change, the current tree
+ * is returned without taking the update lock, so concurrent opens do
+ * not contend.
+ *
+ * \par Errors:
+ * <dl>
+ * <dt>-ENODEV<dd>There is no global configuration.
+ * </dl>
+ * Additionally, any errors encountered when parsing the input or
+ * returned by hooks or functions.
+ */
+int snd_config_update_ref(snd_config_t **top)
+{
+	int err;
+
+	assert(top);
+	*top = NULL;
+	if (snd_config_snapshot_get(top))
+		return 0;
+	snd_config_lock();
+	err = snd_config_update_global();
+	if (err >= 0) {
+		if (snd_config) {
+			__atomic_add_fetch(&snd_config->refcount, 1, __ATOMIC_RELAXED);
+			*top = snd_config;
+		} else {
+			err = -ENODEV;
+		}
+	}
+	snd_config_unlock();
 	return err;
 }
 
+/**
+ * \brief Takes another reference to a configuration tree.
+ * \param[in] top Handle to the tree obtained with #snd_config_update_ref.
+ */
+void snd_config_ref(snd_config_t *top)
+{
+	if (top)
+		__atomic_add_fetch(&top->refcount, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * \brief Releases a reference to a configuration tree.
+ * \param[in] top Handle to the tree obtained with #snd_config_update_ref.
+ *
+ * The tree is freed when its last reference is released and it is no
+ * longer #snd_config.
+ */
+void snd_config_unref(snd_config_t *top)
+{
+	if (top)
+		snd_config_put(top);
+}
+
 /** 
  * \brief Frees a private update structure.
  * \param[in] update The private update structure to free.
@@ -3723,6 +5754,11 @@ int snd_config_update_free(snd_config_update_t *update)
 	for (k = 0; k < update->count; k++)
 		free(update->finfo[k].name);
 	free(update->finfo);
+	if (update->configs) {
+		close(update->notify_fd);
+		free(update->configs);
+		free(update->targets);
+	}
 	free(update);
 	return 0;
 }
@@ -3733,24 +5769,24 @@ int snd_config_update_free(snd_config_update_t *update)
  *
  * This functions releases all resources of the global configuration
  * tree, and sets #snd_config to \c NULL.
+ * A tree still referenced by #snd_config_update_ref is freed with
+ * its last reference.
  *
  * \par Conforming to:
  * LSB 3.2
  */
 int snd_config_update_free_global(void)
 {
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_lock(&snd_config_update_mutex);
-#endif
+	snd_config_lock();
+	snd_config_memo_flush();
+	snd_config_snapshot_publish(NULL);
 	if (snd_config)
-		snd_config_delete(snd_config);
+		snd_config_put(snd_config);
 	snd_config = NULL;
 	if (snd_config_global_update)
 		snd_config_update_free(snd_config_global_update);
 	snd_config_global_update = NULL;
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_unlock(&snd_config_update_mutex);
-#endif
+	snd_config_unlock();
 	/* FIXME: better to place this in another place... */
 	snd_dlobj_cache_cleanup();
 
@@ -3770,12 +5806,23 @@ int snd_config_update_free_global(void)
  * Use #snd_config_iterator_entry to get the handle of the node pointed
  * to.
  *
+ * In a tree obtained with #snd_config_update_ref, the hooks and card
+ * configurations still pending for \a config or its parents are
+ * processed first, so the children do not change during the iteration.
+ *
  * \par Conforming to:
  * LSB 3.2
  */
 snd_config_iterator_t snd_config_iterator_first(const snd_config_t *config)
 {
+	snd_config_t *c = (snd_config_t *)config;
+
 	assert(config->type == SND_CONFIG_TYPE_COMPOUND);
+	/* the pending card configurations belong to the children */
+	if (snd_config_unsettled(c))
+		snd_config_settle(c);
+	else if (c->u.compound.lazy)
+		snd_config_lazy_load(c, NULL, 0);
 	return config->u.compound.fields.next;
 }
 
@@ -3845,21 +5892,24 @@ typedef int (*snd_config_walk_callback_t)(snd_config_t *src,
 					  snd_config_t *root,
 					  snd_config_t **dst,
 					  snd_config_walk_pass_t pass,
-					  snd_config_t *private_data);
+					  snd_config_t *private_data,
+					  struct snd_config_arena *arena);
 #endif
 
+/* arena is used by the callbacks to allocate the new nodes */
 static int snd_config_walk(snd_config_t *src,
 			   snd_config_t *root,
 			   snd_config_t **dst, 
 			   snd_config_walk_callback_t callback,
-			   snd_config_t *private_data)
+			   snd_config_t *private_data,
+			   struct snd_config_arena *arena)
 {
 	int err;
 	snd_config_iterator_t i, next;
 
 	switch (snd_config_get_type(src)) {
 	case SND_CONFIG_TYPE_COMPOUND:
-		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_PRE, private_data);
+		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_PRE, private_data, arena);
 		if (err <= 0)
 			return err;
 		snd_config_for_each(i, next, src) {
@@ -3867,7 +5917,7 @@ static int snd_config_walk(snd_config_t *src,
 			snd_config_t *d = NULL;
 
 			err = snd_config_walk(s, root, (dst && *dst) ? &d : NULL,
-					      callback, private_data);
+					      callback, private_data, arena);
 			if (err < 0)
 				goto _error;
 			if (err && d) {
@@ -3876,7 +5926,7 @@ static int snd_config_walk(snd_config_t *src,
 					goto _error;
 			}
 		}
-		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_POST, private_data);
+		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_POST, private_data, arena);
 		if (err <= 0) {
 		_error:
 			if (dst && *dst)
@@ -3884,7 +5934,7 @@ static int snd_config_walk(snd_config_t *src,
 		}
 		break;
 	default:
-		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_LEAF, private_data);
+		err = callback(src, root, dst, SND_CONFIG_WALK_PASS_LEAF, private_data, arena);
 		break;
 	}
 	return err;
@@ -3894,56 +5944,39 @@ static int _snd_config_copy(snd_config_t *src,
 			    snd_config_t *root ATTRIBUTE_UNUSED,
 			    snd_config_t **dst,
 			    snd_config_walk_pass_t pass,
-			    snd_config_t *private_data ATTRIBUTE_UNUSED)
+			    snd_config_t *private_data ATTRIBUTE_UNUSED,
+			    struct snd_config_arena *arena)
 {
 	int err;
-	const char *id = src->id;
 	snd_config_type_t type = snd_config_get_type(src);
 	switch (pass) {
 	case SND_CONFIG_WALK_PASS_PRE:
-		err = snd_config_make_compound(dst, id, src->u.compound.join);
+		err = snd_config_make_like(arena, dst, src, SND_CONFIG_TYPE_COMPOUND);
 		if (err < 0)
 			return err;
+		(*dst)->u.compound.join = src->u.compound.join;
 		break;
 	case SND_CONFIG_WALK_PASS_LEAF:
-		err = snd_config_make(dst, id, type);
+		err = snd_config_make_like(arena, dst, src, type);
 		if (err < 0)
 			return err;
 		switch (type) {
 		case SND_CONFIG_TYPE_INTEGER:
-		{
-			long v;
-			err = snd_config_get_integer(src, &v);
-			assert(err >= 0);
-			snd_config_set_integer(*dst, v);
+			(*dst)->u.integer = src->u.integer;
 			break;
-		}
 		case SND_CONFIG_TYPE_INTEGER64:
-		{
-			long long v;
-			err = snd_config_get_integer64(src, &v);
-			assert(err >= 0);
-			snd_config_set_integer64(*dst, v);
+			(*dst)->u.integer64 = src->u.integer64;
 			break;
-		}
 		case SND_CONFIG_TYPE_REAL:
-		{
-			double v;
-			err = snd_config_get_real(src, &v);
-			assert(err >= 0);
-			snd_config_set_real(*dst, v);
+			(*dst)->u.real = src->u.real;
 			break;
-		}
 		case SND_CONFIG_TYPE_STRING:
-		{
-			const char *s;
-			err = snd_config_get_string(src, &s);
-			assert(err >= 0);
-			err = snd_config_set_string(*dst, s);
-			if (err < 0)
+			err = snd_config_copy_string(*dst, src);
+			if (err < 0) {
+				snd_config_delete(*dst);
 				return err;
+			}
 			break;
-		}
 		default:
 			assert(0);
 		}
@@ -3975,14 +6008,23 @@ static int _snd_config_copy(snd_config_t *src,
 int snd_config_copy(snd_config_t **dst,
 		    snd_config_t *src)
 {
-	return snd_config_walk(src, NULL, dst, _snd_config_copy, NULL);
+	struct snd_config_arena *arena;
+	int err;
+
+	arena = snd_config_arena_new();
+	if (!arena)
+		return -ENOMEM;
+	err = snd_config_walk(src, NULL, dst, _snd_config_copy, NULL, arena);
+	snd_config_arena_put(arena);
+	return err;
 }
 
 static int _snd_config_expand(snd_config_t *src,
 			      snd_config_t *root ATTRIBUTE_UNUSED,
 			      snd_config_t **dst,
 			      snd_config_walk_pass_t pass,
-			      snd_config_t *private_data)
+			      snd_config_t *private_data,
+			      struct snd_config_arena *arena)
 {
 	int err;
 	const char *id = src->id;
@@ -3992,43 +6034,18 @@ static int _snd_config_expand(snd_config_t *src,
 	{
 		if (id && strcmp(id, "@args") == 0)
 			return 0;
-		err = snd_config_make_compound(dst, id, src->u.compound.join);
+		err = snd_config_make_like(arena, dst, src, SND_CONFIG_TYPE_COMPOUND);
 		if (err < 0)
 			return err;
+		(*dst)->u.compound.join = src->u.compound.join;
 		break;
 	}
 	case SND_CONFIG_WALK_PASS_LEAF:
 		switch (type) {
 		case SND_CONFIG_TYPE_INTEGER:
-		{
-			long v;
-			err = snd_config_get_integer(src, &v);
-			assert(err >= 0);
-			err = snd_config_imake_integer(dst, id, v);
-			if (err < 0)
-				return err;
-			break;
-		}
 		case SND_CONFIG_TYPE_INTEGER64:
-		{
-			long long v;
-			err = snd_config_get_integer64(src, &v);
-			assert(err >= 0);
-			err = snd_config_imake_integer64(dst, id, v);
-			if (err < 0)
-				return err;
-			break;
-		}
 		case SND_CONFIG_TYPE_REAL:
-		{
-			double v;
-			err = snd_config_get_real(src, &v);
-			assert(err >= 0);
-			err = snd_config_imake_real(dst, id, v);
-			if (err < 0)
-				return err;
-			break;
-		}
+			return _snd_config_copy(src, root, dst, pass, NULL, arena);
 		case SND_CONFIG_TYPE_STRING:
 		{
 			const char *s;
@@ -4039,16 +6056,21 @@ static int _snd_config_expand(snd_config_t *src,
 				s++;
 				if (snd_config_search(vars, s, &val) < 0)
 					return 0;
-				err = snd_config_copy(dst, val);
+				err = snd_config_walk(val, NULL, dst, _snd_config_copy, NULL, arena);
 				if (err < 0)
 					return err;
-				err = snd_config_set_id(*dst, id);
-				if (err < 0) {
-					snd_config_delete(*dst);
-					return err;
+				/* the copy is not attached yet, no index to update */
+				snd_config_free_id(*dst);
+				if (id) {
+					(*dst)->id = snd_config_dup_str(arena, src->id);
+					if (!(*dst)->id) {
+						snd_config_delete(*dst);
+						return -ENOMEM;
+					}
+					(*dst)->flags |= SND_CONFIG_ARENA_ID;
 				}
 			} else {
-				err = snd_config_imake_string(dst, id, s);
+				err = _snd_config_copy(src, root, dst, pass, NULL, arena);
 				if (err < 0)
 					return err;
 			}
@@ -4068,7 +6090,8 @@ static int _snd_config_evaluate(snd_config_t *src,
 				snd_config_t *root,
 				snd_config_t **dst ATTRIBUTE_UNUSED,
 				snd_config_walk_pass_t pass,
-				snd_config_t *private_data)
+				snd_config_t *private_data,
+				struct snd_config_arena *arena ATTRIBUTE_UNUSED)
 {
 	int err;
 	if (pass == SND_CONFIG_WALK_PASS_PRE) {
@@ -4186,7 +6209,7 @@ int snd_config_evaluate(snd_config_t *config, snd_config_t *root,
 {
 	/* FIXME: Only in place evaluation is currently implemented */
 	assert(result == NULL);
-	return snd_config_walk(config, root, result, _snd_config_evaluate, private_data);
+	return snd_config_walk(config, root, result, _snd_config_evaluate, private_data, NULL);
 }
 
 static int load_defaults(snd_config_t *subs, snd_config_t *defs)
@@ -4594,6 +6617,7 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 {
 	int err;
 	snd_config_t *defs, *subs = NULL, *res;
+	struct snd_config_arena *arena;
 	err = snd_config_search(config, "@args", &defs);
 	if (err < 0) {
 		if (args != NULL) {
@@ -4622,7 +6646,13 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
 			SNDERR("Args evaluate error: %s", snd_strerror(err));
 			goto _end;
 		}
-		err = snd_config_walk(config, root, &res, _snd_config_expand, subs);
+		arena = snd_config_arena_new();
+		if (!arena) {
+			err = -ENOMEM;
+			goto _end;
+		}
+		err = snd_config_walk(config, root, &res, _snd_config_expand, subs, arena);
+		snd_config_arena_put(arena);
 		if (err < 0) {
 			SNDERR("Expand error (walk): %s", snd_strerror(err));
 			goto _end;
@@ -4662,6 +6692,11 @@ int snd_config_expand(snd_config_t *config, snd_config_t *root, const char *args
  * In any case, \a result is a new node that must be freed by the
  * caller.
  *
+ * If the environment variable \c ALSA_CONFIG_EXPAND_CACHE is set to a
+ * value other than \c 0, the expanded definitions found in #snd_config
+ * are remembered until #snd_config is reread or freed, so the functions
+ * used by a definition are evaluated only at its first lookup.
+ *
  * \par Errors:
  * <dl>
  * <dt>-ENOENT<dd>An id in \a key or an alias id does not exist.
@@ -4678,7 +6713,9 @@ int snd_config_search_definition(snd_config_t *config,
 	snd_config_t *conf;
 	char *key;
 	const char *args = strchr(name, ':');
-	int err;
+	const char *env;
+	unsigned int generation = 0;
+	int memo, err;
 	if (args) {
 		args++;
 		key = alloca(args - name);
@@ -4691,10 +6728,22 @@ int snd_config_search_definition(snd_config_t *config,
 	 *  if key contains dot (.), the implicit base is ignored
 	 *  and the key starts from root given by the 'config' parameter
 	 */
+	env = getenv(ALSA_CONFIG_EXPAND_CACHE_VAR);
+	memo = env && *env && strcmp(env, "0") != 0;
+	if (memo) {
+		err = snd_config_memo_get(config, base, name, result, &generation);
+		if (err > 0)
+			return err;
+		/* on errors just expand without the memo */
+		memo = err == 0;
+	}
 	err = snd_config_search_alias_hooks(config, strchr(key, '.') ? NULL : base, key, &conf);
 	if (err < 0)
 		return err;
-	return snd_config_expand(conf, config, args, NULL, result);
+	err = snd_config_expand(conf, config, args, NULL, result);
+	if (err >= 0 && memo)
+		snd_config_memo_put(base, name, *result, generation);
+	return err;
 }
 
 #ifndef DOC_HIDDEN
@@ -33,11 +33,168 @@
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include "control_local.h"
+#ifdef HAVE_SYS_INOTIFY_H
+#include <sys/inotify.h>
+#endif
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 #define SND_FILE_CONTROL	ALSA_DEVICE_DIRECTORY "controlC%i"
 #define SND_FILE_LOAD		ALOAD_DEVICE_DIRECTORY "aloadC%i"
+#define ALSA_CARD_CACHE_VAR	"ALSA_CARD_CACHE"
+#endif
+
+/*
+ * Process wide cache of the card list.  It is only used while an
+ * inotify watch on the device directory works; any added, removed or
+ * changed device node drops the cached state.
+ */
+static struct {
+	int enabled;			/* 1 watched, -1 not used, 0 not checked */
+	int notify_fd;
+	pid_t notify_pid;		/* process which created the watch */
+	unsigned int generation;	/* bumped on each device change */
+	unsigned int probed;		/* cards with a known presence */
+	unsigned int present;
+	unsigned int info_valid;	/* cards with a cached info */
+	snd_ctl_card_info_t info[32];
+} snd_card_cache;
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t snd_card_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static inline void snd_card_cache_lock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&snd_card_cache_mutex);
+#endif
+}
+
+static inline void snd_card_cache_unlock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&snd_card_cache_mutex);
+#endif
+}
+
+#ifdef HAVE_SYS_INOTIFY_H
+#define SND_CARD_WATCH_MASK	(IN_CREATE | IN_DELETE | IN_ATTRIB | \
+				 IN_MOVED_FROM | IN_MOVED_TO)
+
+static void snd_card_cache_watch(void)
+{
+	const char *env = getenv(ALSA_CARD_CACHE_VAR);
+	int fd;
+
+	snd_card_cache.enabled = -1;
+	if (!env || !*env || strcmp(env, "0") == 0)
+		return;
+	fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0)
+		return;
+	if (inotify_add_watch(fd, ALSA_DEVICE_DIRECTORY, SND_CARD_WATCH_MASK) < 0) {
+		close(fd);
+		return;
+	}
+	snd_card_cache.notify_fd = fd;
+	snd_card_cache.notify_pid = getpid();
+	snd_card_cache.enabled = 1;
+}
+#endif
+
+/*
+ * Drains the pending device events, dropping the cached state if there
+ * were any.  Returns 1 if the cache can be used.  The caller holds the
+ * cache lock.
+ */
+static int snd_card_cache_check(void)
+{
+#ifdef HAVE_SYS_INOTIFY_H
+	char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	ssize_t len;
+	char *p;
+	int changed = 0, lost = 0;
+
+	/*
+	 * A forked child shares the event queue with its parent, either
+	 * may read the events of the other; it needs its own watch.
+	 */
+	if (snd_card_cache.enabled > 0 && snd_card_cache.notify_pid != getpid()) {
+		close(snd_card_cache.notify_fd);
+		snd_card_cache.enabled = 0;
+		changed = 1;
+	}
+	if (snd_card_cache.enabled == 0)
+		snd_card_cache_watch();
+	if (snd_card_cache.enabled < 0)
+		return 0;
+	while ((len = read(snd_card_cache.notify_fd, buf, sizeof(buf))) > 0) {
+		for (p = buf; p < buf + len; p += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *)p;
+			/* the directory itself is gone */
+			if (ev->mask & IN_IGNORED)
+				lost = 1;
+		}
+		changed = 1;
+		if (lost)
+			break;
+	}
+	if (len < 0 && errno != EAGAIN)
+		lost = 1;
+	if (lost) {
+		close(snd_card_cache.notify_fd);
+		snd_card_cache.enabled = -1;
+		changed = 1;
+	}
+	if (changed) {
+		snd_card_cache.generation++;
+		snd_card_cache.probed = 0;
+		snd_card_cache.info_valid = 0;
+	}
+	return snd_card_cache.enabled > 0;
+#else
+	return 0;
 #endif
+}
+
+/*
+ * Gets the generation of the cached card list, which changes with any
+ * device change.  Returns -ENOENT if the card list is not cached.
+ */
+int snd_card_cache_generation(unsigned int *generation)
+{
+	int err = -ENOENT;
+
+	snd_card_cache_lock();
+	if (snd_card_cache_check()) {
+		*generation = snd_card_cache.generation;
+		err = 0;
+	}
+	snd_card_cache_unlock();
+	return err;
+}
+
+/* remembers a probe result unless the devices changed in the meantime */
+static void snd_card_cache_put(int card, unsigned int generation,
+			       const snd_ctl_card_info_t *info)
+{
+	snd_card_cache_lock();
+	if (snd_card_cache.enabled > 0 &&
+	    generation == snd_card_cache.generation) {
+		snd_card_cache.probed |= 1U << card;
+		if (info) {
+			snd_card_cache.present |= 1U << card;
+			snd_card_cache.info_valid |= 1U << card;
+			snd_card_cache.info[card] = *info;
+		} else {
+			snd_card_cache.present &= ~(1U << card);
+		}
+	}
+	snd_card_cache_unlock();
+}
 
 static int snd_card_load2(const char *control)
 {
@@ -68,8 +225,12 @@ static int snd_card_load1(int card)
 #ifdef SUPPORT_ALOAD
 	if (res < 0) {
 		char aload[sizeof(SND_FILE_LOAD) + 10];
+		int err;
 		sprintf(aload, SND_FILE_LOAD, card);
-		res = snd_card_load2(aload);
+		err = snd_card_load2(aload);
+		/* keep the error of an existing control device */
+		if (err >= 0 || res == -ENOENT)
+			res = err;
 	}
 #endif
 	return res;
@@ -85,6 +246,67 @@ int snd_card_load(int card)
 	return !!(snd_card_load1(card) >= 0);
 }
 
+/* reads the card info, using the cache when possible */
+static int snd_card_get_info(int card, snd_ctl_card_info_t *info)
+{
+	snd_ctl_t *handle;
+	unsigned int generation;
+	int cached, err;
+
+	if (card < 0 || card > 31)
+		return -EINVAL;
+	snd_card_cache_lock();
+	cached = snd_card_cache_check();
+	if (cached && (snd_card_cache.probed & (1U << card))) {
+		err = -ENODEV;
+		if (snd_card_cache.info_valid & (1U << card)) {
+			*info = snd_card_cache.info[card];
+			err = 0;
+		}
+		if (err == 0 || !(snd_card_cache.present & (1U << card))) {
+			snd_card_cache_unlock();
+			return err;
+		}
+	}
+	generation = snd_card_cache.generation;
+	snd_card_cache_unlock();
+	err = snd_ctl_hw_open(&handle, NULL, card, 0);
+	if (err >= 0) {
+		err = snd_ctl_card_info(handle, info);
+		snd_ctl_close(handle);
+	}
+	/* other errors do not tell whether the card exists */
+	if (cached && (err >= 0 || err == -ENODEV || err == -ENOENT))
+		snd_card_cache_put(card, generation, err < 0 ? NULL : info);
+	return err;
+}
+
+/* like snd_card_load, using the cache when possible */
+static int snd_card_present(int card)
+{
+	snd_ctl_card_info_t info;
+	unsigned int generation;
+	int cached, present, err;
+
+	snd_card_cache_lock();
+	cached = snd_card_cache_check();
+	if (cached && (snd_card_cache.probed & (1U << card))) {
+		present = !!(snd_card_cache.present & (1U << card));
+		snd_card_cache_unlock();
+		return present;
+	}
+	generation = snd_card_cache.generation;
+	snd_card_cache_unlock();
+	err = snd_card_load1(card);
+	if (cached) {
+		if (err >= 0)
+			snd_card_get_info(card, &info);
+		else if (err == -ENODEV || err == -ENOENT)
+			snd_card_cache_put(card, generation, NULL);
+	}
+	return err >= 0;
+}
+
 /**
  * \brief Try to determine the next card.
  * \param rcard pointer to card number
@@ -94,6 +316,11 @@ int snd_card_load(int card)
  * If card number is -1, then the first available card is
  * returned. If the result card number is -1, no more cards
  * are available.
+ *
+ * If the environment variable \c ALSA_CARD_CACHE is set to a value
+ * other than \c 0, the card list and the card informations are kept
+ * for the whole process while an inotify watch on the device directory
+ * reports no change.
  */
 int snd_card_next(int *rcard)
 {
@@ -104,7 +331,7 @@ int snd_card_next(int *rcard)
 	card = *rcard;
 	card = card < 0 ? 0 : card + 1;
 	for (; card < 32; card++) {
-		if (snd_card_load(card)) {
+		if (snd_card_present(card)) {
 			*rcard = card;
 			return 0;
 		}
@@ -125,7 +352,6 @@ int snd_card_next(int *rcard)
 int snd_card_get_index(const char *string)
 {
 	int card, err;
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 
 	if (!string || *string == '\0')
@@ -145,16 +371,11 @@ int snd_card_get_index(const char *string)
 		return snd_card_load2(string);
 	for (card = 0; card < 32; card++) {
 #ifdef SUPPORT_ALOAD
-		if (! snd_card_load(card))
+		if (! snd_card_present(card))
 			continue;
 #endif
-		if (snd_ctl_hw_open(&handle, NULL, card, 0) < 0)
+		if (snd_card_get_info(card, &info) < 0)
 			continue;
-		if (snd_ctl_card_info(handle, &info) < 0) {
-			snd_ctl_close(handle);
-			continue;
-		}
-		snd_ctl_close(handle);
 		if (!strcmp((const char *)info.id, string))
 			return card;
 	}
@@ -169,19 +390,13 @@ int snd_card_get_index(const char *string)
  */
 int snd_card_get_name(int card, char **name)
 {
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 	int err;
 	
 	if (name == NULL)
 		return -EINVAL;
-	if ((err = snd_ctl_hw_open(&handle, NULL, card, 0)) < 0)
+	if ((err = snd_card_get_info(card, &info)) < 0)
 		return err;
-	if ((err = snd_ctl_card_info(handle, &info)) < 0) {
-		snd_ctl_close(handle);
-		return err;
-	}
-	snd_ctl_close(handle);
 	*name = strdup((const char *)info.name);
 	if (*name == NULL)
 		return -ENOMEM;
@@ -196,19 +411,13 @@ int snd_card_get_name(int card, char **name)
  */
 int snd_card_get_longname(int card, char **name)
 {
-	snd_ctl_t *handle;
 	snd_ctl_card_info_t info;
 	int err;
 	
 	if (name == NULL)
 		return -EINVAL;
-	if ((err = snd_ctl_hw_open(&handle, NULL, card, 0)) < 0)
-		return err;
-	if ((err = snd_ctl_card_info(handle, &info)) < 0) {
-		snd_ctl_close(handle);
+	if ((err = snd_card_get_info(card, &info)) < 0)
 		return err;
-	}
-	snd_ctl_close(handle);
 	*name = strdup((const char *)info.longname);
 	if (*name == NULL)
 		return -ENOMEM;
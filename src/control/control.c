@@ -665,6 +665,29 @@ int snd_ctl_read(snd_ctl_t *ctl, snd_ctl_event_t *event)
 	return (ctl->ops->read)(ctl, event);
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * Reads up to count events, with a single system call when the
+ * backend supports it.  Returns the number of events read, or 0 or a
+ * negative error code like snd_ctl_read() when none is read.
+ */
+int snd_ctl_read_events(snd_ctl_t *ctl, snd_ctl_event_t *events, unsigned int count)
+{
+	unsigned int idx;
+	int res;
+
+	assert(ctl && events && count > 0);
+	if (ctl->ops->read_events)
+		return ctl->ops->read_events(ctl, events, count);
+	for (idx = 0; idx < count; idx++) {
+		res = ctl->ops->read(ctl, &events[idx]);
+		if (res <= 0)
+			return idx > 0 ? (int)idx : res;
+	}
+	return idx;
+}
+#endif
+
 /**
  * \brief Wait for a CTL to become ready (i.e. at least one event pending)
  * \param ctl CTL handle
@@ -916,12 +939,15 @@ static int snd_ctl_open_noupdate(snd_ctl_t **ctlp, snd_config_t *root, const cha
  */
 int snd_ctl_open(snd_ctl_t **ctlp, const char *name, int mode)
 {
+	snd_config_t *top;
 	int err;
 	assert(ctlp && name);
-	err = snd_config_update();
+	err = snd_config_update_ref(&top);
 	if (err < 0)
 		return err;
-	return snd_ctl_open_noupdate(ctlp, snd_config, name, mode);
+	err = snd_ctl_open_noupdate(ctlp, top, name, mode);
+	snd_config_unref(top);
+	return err;
 }
 
 /**
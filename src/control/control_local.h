@@ -49,6 +49,7 @@ typedef struct _snd_ctl_ops {
 	int (*set_power_state)(snd_ctl_t *handle, unsigned int state);
 	int (*get_power_state)(snd_ctl_t *handle, unsigned int *state);
 	int (*read)(snd_ctl_t *handle, snd_ctl_event_t *event);
+	int (*read_events)(snd_ctl_t *handle, snd_ctl_event_t *events, unsigned int count);
 	int (*poll_descriptors_count)(snd_ctl_t *handle);
 	int (*poll_descriptors)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int space);
 	int (*poll_revents)(snd_ctl_t *handle, struct pollfd *pfds, unsigned int nfds, unsigned short *revents);
@@ -75,14 +76,38 @@ struct _snd_hctl_elem {
 	void *callback_private;
 	/* links */
 	snd_hctl_t *hctl;		/* associated handle */
+	snd_hctl_elem_t *numid_next;	/* next in the numid hash chain */
+	snd_hctl_elem_t *name_next;	/* next in the name hash chain */
+	/* cache */
+	unsigned int cached;		/* SND_CTL_EVENT_MASK_INFO, _VALUE if valid */
+	snd_ctl_elem_info_t *info;
+	snd_ctl_elem_value_t *value;
+	/* coalesced events */
+	unsigned int pending;		/* OR of the pending event masks */
+	struct list_head pending_list;	/* links for the pending list */
+	unsigned int level;		/* number of skip list links */
+	snd_hctl_elem_t *skip[1];	/* skip list links, must be last */
 };
 
+#define HCTL_SKIP_MAX	16
+#define HCTL_EVENT_BATCH	32
+
 struct _snd_hctl {
 	snd_ctl_t *ctl;
 	struct list_head elems;		/* list of all controls */
-	unsigned int alloc;	
 	unsigned int count;
-	snd_hctl_elem_t **pelems;
+	snd_hctl_elem_t *skip[HCTL_SKIP_MAX];	/* skip list heads */
+	unsigned int level;		/* levels in use */
+	unsigned int seed;		/* for the skip list levels */
+	int cache;			/* cache element info and values */
+	int coalesce;			/* one callback per element per drain */
+	struct list_head pending;	/* elements with coalesced events */
+	snd_ctl_event_t events[HCTL_EVENT_BATCH];	/* read but not handled */
+	unsigned int event_pos;
+	unsigned int event_count;
+	unsigned int hash_size;		/* power of two, 0 if not hashed */
+	snd_hctl_elem_t **numid_hash;	/* elements by numid */
+	snd_hctl_elem_t **name_hash;	/* elements by iface, device, name, index */
 	snd_hctl_compare_t compare;
 	snd_hctl_callback_t callback;
 	void *callback_private;
@@ -91,8 +116,10 @@ struct _snd_hctl {
 
 /* make local functions really local */
 #define snd_ctl_new	snd1_ctl_new
+#define snd_ctl_read_events	snd1_ctl_read_events
 
 int snd_ctl_new(snd_ctl_t **ctlp, snd_ctl_type_t type, const char *name);
+int snd_ctl_read_events(snd_ctl_t *ctl, snd_ctl_event_t *events, unsigned int count);
 int _snd_ctl_poll_descriptor(snd_ctl_t *ctl);
 #define _snd_ctl_async_descriptor _snd_ctl_poll_descriptor
 int snd_ctl_hw_open(snd_ctl_t **handle, const char *name, int card, int mode);
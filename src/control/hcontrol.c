@@ -44,6 +44,7 @@ to reduce overhead accessing the real controls in kernel drivers.
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <unistd.h>
 #include <string.h>
 #include <fcntl.h>
@@ -52,9 +53,6 @@ to reduce overhead accessing the real controls in kernel drivers.
 #define __USE_GNU
 #endif
 #include "control_local.h"
-#ifdef HAVE_LIBPTHREAD
-#include <pthread.h>
-#endif
 
 #ifndef DOC_HIDDEN
 #define NOT_FOUND 1000000000
@@ -98,7 +96,9 @@ int snd_hctl_open_ctl(snd_hctl_t **hctlp, snd_ctl_t *ctl)
 	if ((hctl = (snd_hctl_t *)calloc(1, sizeof(snd_hctl_t))) == NULL)
 		return -ENOMEM;
 	INIT_LIST_HEAD(&hctl->elems);
+	INIT_LIST_HEAD(&hctl->pending);
 	hctl->ctl = ctl;
+	hctl->seed = 0x2545f491;
 	*hctlp = hctl;
 	return 0;
 }
@@ -320,81 +320,300 @@ static int get_compare_weight(const snd_ctl_elem_id_t *id)
 	return res + res1;
 }
 
-static int _snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id, int *dir)
+/*
+ * The elements are kept in compare order in a skip list, whose lowest
+ * level is the list of all elements, so adding and removing an element
+ * takes logarithmic time.  Besides that, the elements are hashed by
+ * numid and by the full identifier, so lookups with the default or the
+ * fast compare function and the dispatching of events do not need to
+ * call the (expensive) compare function at all.
+ */
+static unsigned int snd_hctl_random_level(snd_hctl_t *hctl)
 {
-	unsigned int l, u;
-	snd_hctl_elem_t el;
-	int c = 0;
-	int idx = -1;
-	assert(hctl && id);
-	assert(hctl->compare);
-	el.id = *id;
-	el.compare_weight = get_compare_weight(id);
-	l = 0;
-	u = hctl->count;
-	while (l < u) {
-		idx = (l + u) / 2;
-		c = hctl->compare(&el, hctl->pelems[idx]);
-		if (c < 0)
-			u = idx;
-		else if (c > 0)
-			l = idx + 1;
-		else
-			break;
+	unsigned int x = hctl->seed, level = 1;
+
+	/* xorshift32 */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	hctl->seed = x;
+	/* one element of four is promoted to the next level */
+	while (level < HCTL_SKIP_MAX && (x & 3) == 0) {
+		level++;
+		x >>= 2;
 	}
-	*dir = c;
-	return idx;
+	return level;
 }
 
-static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+static snd_hctl_elem_t *snd_hctl_elem_new(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
 {
-	int dir;
-	int idx; 
+	unsigned int level = snd_hctl_random_level(hctl);
+	snd_hctl_elem_t *elem;
+
+	elem = calloc(1, offsetof(snd_hctl_elem_t, skip) + level * sizeof(elem->skip[0]));
+	if (elem == NULL)
+		return NULL;
+	elem->id = *id;
+	elem->hctl = hctl;
+	elem->level = level;
 	elem->compare_weight = get_compare_weight(&elem->id);
-	if (hctl->count == hctl->alloc) {
-		snd_hctl_elem_t **h;
-		hctl->alloc += 32;
-		h = realloc(hctl->pelems, sizeof(*h) * hctl->alloc);
-		if (!h) {
-			hctl->alloc -= 32;
-			return -ENOMEM;
+	return elem;
+}
+
+/* the link at level lvl after x, x is NULL for the head */
+static inline snd_hctl_elem_t **snd_hctl_skip_link(snd_hctl_t *hctl, snd_hctl_elem_t *x,
+						   unsigned int lvl)
+{
+	return x ? &x->skip[lvl] : &hctl->skip[lvl];
+}
+
+/*
+ * Returns the first element not less than key.  If update is not NULL,
+ * it receives the last element less than key on each level.
+ */
+static snd_hctl_elem_t *snd_hctl_skip_search(snd_hctl_t *hctl, const snd_hctl_elem_t *key,
+					     snd_hctl_elem_t **update)
+{
+	snd_hctl_elem_t *x = NULL, *n;
+	int lvl;
+
+	for (lvl = (int)hctl->level - 1; lvl >= 0; lvl--) {
+		while ((n = *snd_hctl_skip_link(hctl, x, lvl)) != NULL &&
+		       hctl->compare(key, n) > 0)
+			x = n;
+		if (update)
+			update[lvl] = x;
+	}
+	return *snd_hctl_skip_link(hctl, x, 0);
+}
+
+static void snd_hctl_skip_insert(snd_hctl_t *hctl, snd_hctl_elem_t *elem,
+				 snd_hctl_elem_t **update)
+{
+	snd_hctl_elem_t **link;
+	unsigned int lvl;
+
+	for (lvl = hctl->level; lvl < elem->level; lvl++)
+		update[lvl] = NULL;
+	if (elem->level > hctl->level)
+		hctl->level = elem->level;
+	for (lvl = 0; lvl < elem->level; lvl++) {
+		link = snd_hctl_skip_link(hctl, update[lvl], lvl);
+		elem->skip[lvl] = *link;
+		*link = elem;
+	}
+	list_add(&elem->list, update[0] ? &update[0]->list : &hctl->elems);
+}
+
+/*
+ * The predecessor of elem on a level is the closest preceding element
+ * which has a link on that level, so it is found by walking back the
+ * list without comparing anything.
+ */
+static void snd_hctl_skip_remove(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	struct list_head *pos = elem->list.prev;
+	snd_hctl_elem_t *x;
+	unsigned int lvl;
+
+	for (lvl = 0; lvl < elem->level; lvl++) {
+		while (pos != &hctl->elems &&
+		       list_entry(pos, snd_hctl_elem_t, list)->level <= lvl)
+			pos = pos->prev;
+		x = pos == &hctl->elems ? NULL : list_entry(pos, snd_hctl_elem_t, list);
+		*snd_hctl_skip_link(hctl, x, lvl) = elem->skip[lvl];
+	}
+	while (hctl->level > 0 && hctl->skip[hctl->level - 1] == NULL)
+		hctl->level--;
+	list_del(&elem->list);
+}
+
+#define HCTL_HASH_MIN	64
+
+static inline unsigned int snd_hctl_numid_hash(snd_hctl_t *hctl, unsigned int numid)
+{
+	return numid & (hctl->hash_size - 1);
+}
+
+static unsigned int snd_hctl_name_hash(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
+{
+	const unsigned char *p = id->name;
+	unsigned int hash = 2166136261U;
+
+	while (*p)
+		hash = (hash ^ *p++) * 16777619U;
+	hash = (hash ^ id->iface) * 16777619U;
+	hash = (hash ^ id->device) * 16777619U;
+	hash = (hash ^ id->subdevice) * 16777619U;
+	hash = (hash ^ id->index) * 16777619U;
+	return hash & (hctl->hash_size - 1);
+}
+
+static int snd_hctl_id_equal(const snd_ctl_elem_id_t *id1, const snd_ctl_elem_id_t *id2)
+{
+	return id1->iface == id2->iface &&
+	       id1->device == id2->device &&
+	       id1->subdevice == id2->subdevice &&
+	       id1->index == id2->index &&
+	       strcmp((const char *)id1->name, (const char *)id2->name) == 0;
+}
+
+static void snd_hctl_hash_link(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	unsigned int h;
+
+	/* some plugins report added elements without numid */
+	if (elem->id.numid) {
+		h = snd_hctl_numid_hash(hctl, elem->id.numid);
+		elem->numid_next = hctl->numid_hash[h];
+		hctl->numid_hash[h] = elem;
+	}
+	h = snd_hctl_name_hash(hctl, &elem->id);
+	elem->name_next = hctl->name_hash[h];
+	hctl->name_hash[h] = elem;
+}
+
+static void snd_hctl_hash_free(snd_hctl_t *hctl)
+{
+	free(hctl->numid_hash);
+	free(hctl->name_hash);
+	hctl->numid_hash = NULL;
+	hctl->name_hash = NULL;
+	hctl->hash_size = 0;
+}
+
+/* rebuilds the hashes for at least count elements */
+static void snd_hctl_hash_build(snd_hctl_t *hctl, unsigned int count)
+{
+	unsigned int size = HCTL_HASH_MIN;
+	struct list_head *pos;
+
+	while (size < count)
+		size *= 2;
+	snd_hctl_hash_free(hctl);
+	hctl->numid_hash = calloc(size, sizeof(*hctl->numid_hash));
+	hctl->name_hash = calloc(size, sizeof(*hctl->name_hash));
+	if (!hctl->numid_hash || !hctl->name_hash) {
+		/* fall back to the binary search */
+		snd_hctl_hash_free(hctl);
+		return;
+	}
+	hctl->hash_size = size;
+	list_for_each(pos, &hctl->elems)
+		snd_hctl_hash_link(hctl, list_entry(pos, snd_hctl_elem_t, list));
+}
+
+/* called after elem was counted in hctl->count */
+static void snd_hctl_hash_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	if (hctl->count > hctl->hash_size) {
+		/* the rebuilt hashes already contain elem */
+		snd_hctl_hash_build(hctl, hctl->hash_size * 2);
+		return;
+	}
+	snd_hctl_hash_link(hctl, elem);
+}
+
+static void snd_hctl_hash_remove(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	snd_hctl_elem_t **p;
+
+	if (!hctl->hash_size)
+		return;
+	p = &hctl->numid_hash[snd_hctl_numid_hash(hctl, elem->id.numid)];
+	for (; elem->id.numid && *p; p = &(*p)->numid_next) {
+		if (*p == elem) {
+			*p = elem->numid_next;
+			break;
 		}
-		hctl->pelems = h;
 	}
-	if (hctl->count == 0) {
-		list_add_tail(&elem->list, &hctl->elems);
-		hctl->pelems[0] = elem;
-	} else {
-		idx = _snd_hctl_find_elem(hctl, &elem->id, &dir);
-		assert(dir != 0);
-		if (dir > 0) {
-			list_add(&elem->list, &hctl->pelems[idx]->list);
-			idx++;
-		} else {
-			list_add_tail(&elem->list, &hctl->pelems[idx]->list);
+	for (p = &hctl->name_hash[snd_hctl_name_hash(hctl, &elem->id)];
+	     *p; p = &(*p)->name_next) {
+		if (*p == elem) {
+			*p = elem->name_next;
+			break;
 		}
-		memmove(hctl->pelems + idx + 1,
-			hctl->pelems + idx,
-			(hctl->count - idx) * sizeof(snd_hctl_elem_t *));
-		hctl->pelems[idx] = elem;
 	}
+}
+
+static snd_hctl_elem_t *snd_hctl_hash_find_numid(snd_hctl_t *hctl, unsigned int numid)
+{
+	snd_hctl_elem_t *elem;
+
+	elem = hctl->numid_hash[snd_hctl_numid_hash(hctl, numid)];
+	for (; elem; elem = elem->numid_next) {
+		if (elem->id.numid == numid)
+			return elem;
+	}
+	return NULL;
+}
+
+static snd_hctl_elem_t *snd_hctl_hash_find_name(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
+{
+	snd_hctl_elem_t *elem;
+
+	elem = hctl->name_hash[snd_hctl_name_hash(hctl, id)];
+	for (; elem; elem = elem->name_next) {
+		if (snd_hctl_id_equal(&elem->id, id))
+			return elem;
+	}
+	return NULL;
+}
+
+/*
+ * Returns the element the compare function considers equal to id, or
+ * NULL.  Only the default and the fast compare functions are known to
+ * the hashes.
+ */
+static snd_hctl_elem_t *snd_hctl_lookup(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
+{
+	snd_hctl_elem_t el, *elem;
+
+	if (hctl->hash_size) {
+		if (hctl->compare == snd_hctl_compare_fast && id->numid)
+			return snd_hctl_hash_find_numid(hctl, id->numid);
+		if (hctl->compare == snd_hctl_compare_default) {
+			if (id->numid) {
+				elem = snd_hctl_hash_find_numid(hctl, id->numid);
+				if (elem && snd_hctl_id_equal(&elem->id, id))
+					return elem;
+			}
+			return snd_hctl_hash_find_name(hctl, id);
+		}
+	}
+	assert(hctl->compare);
+	el.id = *id;
+	el.compare_weight = get_compare_weight(id);
+	elem = snd_hctl_skip_search(hctl, &el, NULL);
+	if (elem && hctl->compare(&el, elem) == 0)
+		return elem;
+	return NULL;
+}
+
+static int snd_hctl_elem_add(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
+{
+	snd_hctl_elem_t *update[HCTL_SKIP_MAX];
+	snd_hctl_elem_t *next ATTRIBUTE_UNUSED;
+
+	next = snd_hctl_skip_search(hctl, elem, update);
+	assert(next == NULL || hctl->compare(elem, next) != 0);
+	snd_hctl_skip_insert(hctl, elem, update);
 	hctl->count++;
+	snd_hctl_hash_add(hctl, elem);
 	return snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD, elem);
 }
 
-static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
+static void snd_hctl_elem_remove(snd_hctl_t *hctl, snd_hctl_elem_t *elem)
 {
-	snd_hctl_elem_t *elem = hctl->pelems[idx];
-	unsigned int m;
 	snd_hctl_elem_throw_event(elem, SNDRV_CTL_EVENT_MASK_REMOVE);
-	list_del(&elem->list);
+	snd_hctl_hash_remove(hctl, elem);
+	snd_hctl_skip_remove(hctl, elem);
+	if (elem->pending)
+		list_del(&elem->pending_list);
+	free(elem->info);
+	free(elem->value);
 	free(elem);
 	hctl->count--;
-	m = hctl->count - idx;
-	if (m > 0)
-		memmove(hctl->pelems + idx,
-			hctl->pelems + idx + 1,
-			m * sizeof(snd_hctl_elem_t *));
 }
 
 /**
@@ -404,42 +623,69 @@ static void snd_hctl_elem_remove(snd_hctl_t *hctl, unsigned int idx)
  */
 int snd_hctl_free(snd_hctl_t *hctl)
 {
-	while (hctl->count > 0)
-		snd_hctl_elem_remove(hctl, hctl->count - 1);
-	free(hctl->pelems);
-	hctl->pelems = 0;
-	hctl->alloc = 0;
-	INIT_LIST_HEAD(&hctl->elems);
+	hctl->event_pos = hctl->event_count = 0;
+	snd_hctl_hash_free(hctl);
+	while (!list_empty(&hctl->elems))
+		snd_hctl_elem_remove(hctl, list_entry(hctl->elems.prev,
+						      snd_hctl_elem_t, list));
 	return 0;
 }
 
-static snd_hctl_t *compare_hctl;
-static int hctl_compare(const void *a, const void *b) {
-	return compare_hctl->compare(*(const snd_hctl_elem_t * const *) a,
-			     *(const snd_hctl_elem_t * const *) b);
+/* stable merge sort, tmp has room for n elements */
+static void snd_hctl_merge_sort(snd_hctl_t *hctl, snd_hctl_elem_t **a,
+				snd_hctl_elem_t **tmp, unsigned int n)
+{
+	unsigned int h = n / 2, i = 0, j = h, k = 0;
+
+	if (n < 2)
+		return;
+	snd_hctl_merge_sort(hctl, a, tmp, h);
+	snd_hctl_merge_sort(hctl, a + h, tmp, n - h);
+	if (hctl->compare(a[h - 1], a[h]) <= 0)
+		return;
+	memcpy(tmp, a, n * sizeof(*a));
+	while (i < h && j < n)
+		a[k++] = hctl->compare(tmp[j], tmp[i]) < 0 ? tmp[j++] : tmp[i++];
+	while (i < h)
+		a[k++] = tmp[i++];
+	while (j < n)
+		a[k++] = tmp[j++];
 }
 
-static void snd_hctl_sort(snd_hctl_t *hctl)
+/* sorts the list of elements and links the skip list along it */
+static int snd_hctl_sort(snd_hctl_t *hctl)
 {
-	unsigned int k;
-#ifdef HAVE_LIBPTHREAD
-	static pthread_mutex_t sync_lock = PTHREAD_MUTEX_INITIALIZER;
-#endif
+	snd_hctl_elem_t **a, **last[HCTL_SKIP_MAX];
+	struct list_head *pos;
+	unsigned int k, lvl;
 
 	assert(hctl);
 	assert(hctl->compare);
+	a = malloc((2 * hctl->count + 1) * sizeof(*a));
+	if (a == NULL)
+		return -ENOMEM;
+	k = 0;
+	list_for_each(pos, &hctl->elems)
+		a[k++] = list_entry(pos, snd_hctl_elem_t, list);
+	snd_hctl_merge_sort(hctl, a, a + hctl->count, hctl->count);
 	INIT_LIST_HEAD(&hctl->elems);
-
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_lock(&sync_lock);
-#endif
-	compare_hctl = hctl;
-	qsort(hctl->pelems, hctl->count, sizeof(*hctl->pelems), hctl_compare);
-#ifdef HAVE_LIBPTHREAD
-	pthread_mutex_unlock(&sync_lock);
-#endif
-	for (k = 0; k < hctl->count; k++)
-		list_add_tail(&hctl->pelems[k]->list, &hctl->elems);
+	for (lvl = 0; lvl < HCTL_SKIP_MAX; lvl++)
+		last[lvl] = &hctl->skip[lvl];
+	hctl->level = 0;
+	for (k = 0; k < hctl->count; k++) {
+		snd_hctl_elem_t *elem = a[k];
+		list_add_tail(&elem->list, &hctl->elems);
+		for (lvl = 0; lvl < elem->level; lvl++) {
+			*last[lvl] = elem;
+			last[lvl] = &elem->skip[lvl];
+		}
+		if (elem->level > hctl->level)
+			hctl->level = elem->level;
+	}
+	for (lvl = 0; lvl < HCTL_SKIP_MAX; lvl++)
+		*last[lvl] = NULL;
+	free(a);
+	return 0;
 }
 
 /**
@@ -452,8 +698,7 @@ int snd_hctl_set_compare(snd_hctl_t *hctl, snd_hctl_compare_t compare)
 {
 	assert(hctl);
 	hctl->compare = compare == NULL ? snd_hctl_compare_default : compare;
-	snd_hctl_sort(hctl);
-	return 0;
+	return snd_hctl_sort(hctl);
 }
 
 /**
@@ -553,11 +798,8 @@ snd_hctl_elem_t *snd_hctl_elem_prev(snd_hctl_elem_t *elem)
  */
 snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *id)
 {
-	int dir;
-	int res = _snd_hctl_find_elem(hctl, id, &dir);
-	if (res < 0 || dir != 0)
-		return NULL;
-	return hctl->pelems[res];
+	assert(hctl && id);
+	return snd_hctl_lookup(hctl, id);
 }
 
 /**
@@ -568,6 +810,7 @@ snd_hctl_elem_t *snd_hctl_find_elem(snd_hctl_t *hctl, const snd_ctl_elem_id_t *i
 int snd_hctl_load(snd_hctl_t *hctl)
 {
 	snd_ctl_elem_list_t list;
+	struct list_head *pos;
 	int err = 0;
 	unsigned int idx;
 
@@ -585,36 +828,25 @@ int snd_hctl_load(snd_hctl_t *hctl)
 		if ((err = snd_ctl_elem_list(hctl->ctl, &list)) < 0)
 			goto _end;
 	}
-	if (hctl->alloc < list.count) {
-		hctl->alloc = list.count;
-		free(hctl->pelems);
-		hctl->pelems = malloc(hctl->alloc * sizeof(*hctl->pelems));
-		if (!hctl->pelems) {
-			err = -ENOMEM;
-			goto _end;
-		}
-	}
 	for (idx = 0; idx < list.count; idx++) {
 		snd_hctl_elem_t *elem;
-		elem = calloc(1, sizeof(snd_hctl_elem_t));
+		elem = snd_hctl_elem_new(hctl, &list.pids[idx]);
 		if (elem == NULL) {
-			snd_hctl_free(hctl);
 			err = -ENOMEM;
-			goto _end;
+			goto _free;
 		}
-		elem->id = list.pids[idx];
-		elem->hctl = hctl;
-		elem->compare_weight = get_compare_weight(&elem->id);
-		hctl->pelems[idx] = elem;
 		list_add_tail(&elem->list, &hctl->elems);
 		hctl->count++;
 	}
 	if (!hctl->compare)
 		hctl->compare = snd_hctl_compare_default;
-	snd_hctl_sort(hctl);
-	for (idx = 0; idx < hctl->count; idx++) {
+	err = snd_hctl_sort(hctl);
+	if (err < 0)
+		goto _free;
+	snd_hctl_hash_build(hctl, hctl->count);
+	list_for_each(pos, &hctl->elems) {
 		int res = snd_hctl_throw_event(hctl, SNDRV_CTL_EVENT_MASK_ADD,
-					       hctl->pelems[idx]);
+					       list_entry(pos, snd_hctl_elem_t, list));
 		if (res < 0)
 			return res;
 	}
@@ -622,6 +854,15 @@ int snd_hctl_load(snd_hctl_t *hctl)
  _end:
 	free(list.pids);
 	return err;
+ _free:
+	/* the skip list is not linked yet */
+	while (!list_empty(&hctl->elems)) {
+		snd_hctl_elem_t *elem = list_entry(hctl->elems.next, snd_hctl_elem_t, list);
+		list_del(&elem->list);
+		free(elem);
+	}
+	hctl->count = 0;
+	goto _end;
 }
 
 /**
@@ -729,9 +970,50 @@ snd_ctl_t *snd_hctl_ctl(snd_hctl_t *hctl)
 	return hctl->ctl;
 }
 
+/**
+ * \brief Enable or disable coalescing of element events
+ * \param hctl HCTL handle
+ * \param enable 0 = disable, 1 = enable
+ * \return 0 on success otherwise a negative error code
+ *
+ * With coalescing enabled, snd_hctl_handle_events() invokes the callback
+ * of an element once for all the value and info events of the element
+ * it has read, with the OR of their masks, after all the pending events
+ * are read.
+ */
+int snd_hctl_set_coalesce(snd_hctl_t *hctl, int enable)
+{
+	assert(hctl);
+	hctl->coalesce = enable;
+	return 0;
+}
+
+static int snd_hctl_elem_flush(snd_hctl_elem_t *elem)
+{
+	unsigned int mask = elem->pending;
+
+	elem->pending = 0;
+	list_del(&elem->pending_list);
+	return snd_hctl_elem_throw_event(elem, mask);
+}
+
+static int snd_hctl_flush(snd_hctl_t *hctl)
+{
+	int res;
+
+	while (!list_empty(&hctl->pending)) {
+		res = snd_hctl_elem_flush(list_entry(hctl->pending.next,
+						     snd_hctl_elem_t, pending_list));
+		if (res < 0)
+			return res;
+	}
+	return 0;
+}
+
 static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 {
 	snd_hctl_elem_t *elem;
+	unsigned int mask;
 	int res;
 
 	assert(hctl);
@@ -743,33 +1025,47 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
 		return 0;
 	}
 	if (event->data.elem.mask == SNDRV_CTL_EVENT_MASK_REMOVE) {
-		int dir;
-		res = _snd_hctl_find_elem(hctl, &event->data.elem.id, &dir);
-		assert(res >= 0 && dir == 0);
-		if (res < 0 || dir != 0)
+		elem = snd_hctl_lookup(hctl, &event->data.elem.id);
+		assert(elem);
+		if (!elem)
 			return -ENOENT;
-		snd_hctl_elem_remove(hctl, (unsigned int) res);
+		/* deliver the coalesced events before the removal */
+		if (elem->pending) {
+			res = snd_hctl_elem_flush(elem);
+			if (res < 0)
+				return res;
+		}
+		snd_hctl_elem_remove(hctl, elem);
 		return 0;
 	}
 	if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_ADD) {
-		elem = calloc(1, sizeof(snd_hctl_elem_t));
+		elem = snd_hctl_elem_new(hctl, &event->data.elem.id);
 		if (elem == NULL)
 			return -ENOMEM;
-		elem->id = event->data.elem.id;
-		elem->hctl = hctl;
 		res = snd_hctl_elem_add(hctl, elem);
 		if (res < 0)
 			return res;
 	}
 	if (event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
 				     SNDRV_CTL_EVENT_MASK_INFO)) {
-		elem = snd_hctl_find_elem(hctl, &event->data.elem.id);
+		elem = snd_hctl_lookup(hctl, &event->data.elem.id);
 		assert(elem);
 		if (!elem)
 			return -ENOENT;
-		res = snd_hctl_elem_throw_event(elem, event->data.elem.mask &
-						(SNDRV_CTL_EVENT_MASK_VALUE |
-						 SNDRV_CTL_EVENT_MASK_INFO));
+		/* the value may be reinterpreted after an info change */
+		if (event->data.elem.mask & SNDRV_CTL_EVENT_MASK_INFO)
+			elem->cached = 0;
+		else
+			elem->cached &= ~SNDRV_CTL_EVENT_MASK_VALUE;
+		mask = event->data.elem.mask & (SNDRV_CTL_EVENT_MASK_VALUE |
+						SNDRV_CTL_EVENT_MASK_INFO);
+		if (hctl->coalesce) {
+			if (!elem->pending)
+				list_add_tail(&elem->pending_list, &hctl->pending);
+			elem->pending |= mask;
+			return 0;
+		}
+		res = snd_hctl_elem_throw_event(elem, mask);
 		if (res < 0)
 			return res;
 	}
@@ -783,24 +1079,84 @@ static int snd_hctl_handle_event(snd_hctl_t *hctl, snd_ctl_event_t *event)
  */
 int snd_hctl_handle_events(snd_hctl_t *hctl)
 {
-	snd_ctl_event_t event;
 	int res;
 	unsigned int count = 0;
 	
 	assert(hctl);
 	assert(hctl->ctl);
-	while ((res = snd_ctl_read(hctl->ctl, &event)) != 0 &&
-	       res != -EAGAIN) {
-		if (res < 0)
-			return res;
-		res = snd_hctl_handle_event(hctl, &event);
+	for (;;) {
+		/* events left over by a failed callback come first */
+		if (hctl->event_pos == hctl->event_count) {
+			hctl->event_pos = hctl->event_count = 0;
+			res = snd_ctl_read_events(hctl->ctl, hctl->events,
+						  HCTL_EVENT_BATCH);
+			if (res == 0 || res == -EAGAIN)
+				break;
+			if (res < 0)
+				return res;
+			hctl->event_count = res;
+		}
+		res = snd_hctl_handle_event(hctl, &hctl->events[hctl->event_pos++]);
 		if (res < 0)
 			return res;
 		count++;
 	}
+	res = snd_hctl_flush(hctl);
+	if (res < 0)
+		return res;
 	return count;
 }
 
+/**
+ * \brief Enable or disable the cache of element information and values
+ * \param hctl HCTL handle
+ * \param enable 0 = disable, 1 = enable
+ * \return 0 on success otherwise a negative error code
+ *
+ * With the cache enabled, snd_hctl_elem_info() and snd_hctl_elem_read()
+ * return the last information and value of an element without asking
+ * the driver again, until an info or value event for the element is
+ * handled by snd_hctl_handle_events().  The cache is thus only accurate
+ * when the application handles the pending events before reading.
+ * Values of volatile elements are never cached.
+ */
+int snd_hctl_set_cache(snd_hctl_t *hctl, int enable)
+{
+	struct list_head *pos;
+
+	assert(hctl);
+	hctl->cache = enable;
+	list_for_each(pos, &hctl->elems) {
+		snd_hctl_elem_t *elem = list_entry(pos, snd_hctl_elem_t, list);
+		elem->cached = 0;
+		free(elem->info);
+		elem->info = NULL;
+		free(elem->value);
+		elem->value = NULL;
+	}
+	return 0;
+}
+
+static int snd_hctl_elem_info_cached(snd_hctl_elem_t *elem)
+{
+	int err;
+
+	if (elem->cached & SNDRV_CTL_EVENT_MASK_INFO)
+		return 0;
+	if (elem->info == NULL) {
+		elem->info = calloc(1, sizeof(*elem->info));
+		if (elem->info == NULL)
+			return -ENOMEM;
+	}
+	elem->info->id = elem->id;
+	elem->info->value.enumerated.item = 0;
+	err = snd_ctl_elem_info(elem->hctl->ctl, elem->info);
+	if (err < 0)
+		return err;
+	elem->cached |= SNDRV_CTL_EVENT_MASK_INFO;
+	return 0;
+}
+
 /**
  * \brief Get information for an HCTL element
  * \param elem HCTL element
@@ -809,9 +1165,22 @@ int snd_hctl_handle_events(snd_hctl_t *hctl)
  */
 int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
 {
+	int err;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(info);
+	if (elem->hctl->cache) {
+		err = snd_hctl_elem_info_cached(elem);
+		if (err < 0)
+			return err;
+		/* the enumerated item name depends on the requested item */
+		if (elem->info->type != SNDRV_CTL_ELEM_TYPE_ENUMERATED ||
+		    info->value.enumerated.item == elem->info->value.enumerated.item) {
+			*info = *elem->info;
+			return 0;
+		}
+	}
 	info->id = elem->id;
 	return snd_ctl_elem_info(elem->hctl->ctl, info);
 }
@@ -824,11 +1193,36 @@ int snd_hctl_elem_info(snd_hctl_elem_t *elem, snd_ctl_elem_info_t *info)
  */
 int snd_hctl_elem_read(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 {
+	int err;
+
 	assert(elem);
 	assert(elem->hctl);
 	assert(value);
-	value->id = elem->id;
-	return snd_ctl_elem_read(elem->hctl->ctl, value);
+	if (!elem->hctl->cache) {
+		value->id = elem->id;
+		return snd_ctl_elem_read(elem->hctl->ctl, value);
+	}
+	if (!(elem->cached & SNDRV_CTL_EVENT_MASK_VALUE)) {
+		err = snd_hctl_elem_info_cached(elem);
+		if (err < 0)
+			return err;
+		if (elem->info->access & SNDRV_CTL_ELEM_ACCESS_VOLATILE) {
+			value->id = elem->id;
+			return snd_ctl_elem_read(elem->hctl->ctl, value);
+		}
+		if (elem->value == NULL) {
+			elem->value = calloc(1, sizeof(*elem->value));
+			if (elem->value == NULL)
+				return -ENOMEM;
+		}
+		elem->value->id = elem->id;
+		err = snd_ctl_elem_read(elem->hctl->ctl, elem->value);
+		if (err < 0)
+			return err;
+		elem->cached |= SNDRV_CTL_EVENT_MASK_VALUE;
+	}
+	*value = *elem->value;
+	return 0;
 }
 
 /**
@@ -845,6 +1239,8 @@ int snd_hctl_elem_write(snd_hctl_elem_t *elem, snd_ctl_elem_value_t * value)
 	assert(elem->hctl);
 	assert(value);
 	value->id = elem->id;
+	/* the driver may adjust the written value */
+	elem->cached &= ~SNDRV_CTL_EVENT_MASK_VALUE;
 	return snd_ctl_elem_write(elem->hctl->ctl, value);
 }
 
@@ -26,9 +26,13 @@
  */
 
 #include "local.h"
+#ifdef HAVE_LIBPTHREAD
+#include <pthread.h>
+#endif
 
 #ifndef DOC_HIDDEN
 struct hint_list {
+	snd_config_t *config;
 	char **list;
 	unsigned int count;
 	unsigned int allocated;
@@ -44,8 +48,135 @@ struct hint_list {
 	int show_all;
 	char *cardname;
 };
+
+struct hint_cache {
+	struct list_head list;
+	snd_ctl_elem_iface_t iface;
+	int card;
+	char **hints;			/* NULL terminated */
+};
 #endif
 
+/*
+ * Hints built from hint_cache_config while the card list had the
+ * generation hint_cache_generation.  The cache holds a reference to
+ * the configuration, so a new tree cannot get the same address.
+ */
+static LIST_HEAD(hint_cache_list);
+static snd_config_t *hint_cache_config;
+static unsigned int hint_cache_generation;
+#ifdef HAVE_LIBPTHREAD
+static pthread_mutex_t hint_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static inline void hint_cache_lock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_lock(&hint_cache_mutex);
+#endif
+}
+
+static inline void hint_cache_unlock(void)
+{
+#ifdef HAVE_LIBPTHREAD
+	pthread_mutex_unlock(&hint_cache_mutex);
+#endif
+}
+
+static char **hint_copy(char **hints)
+{
+	unsigned int k, count;
+	char **res;
+
+	for (count = 0; hints[count]; count++)
+		;
+	res = malloc((count + 1) * sizeof(*res));
+	if (res == NULL)
+		return NULL;
+	for (k = 0; k < count; k++) {
+		res[k] = strdup(hints[k]);
+		if (res[k] == NULL) {
+			snd_device_name_free_hint((void **)res);
+			return NULL;
+		}
+	}
+	res[count] = NULL;
+	return res;
+}
+
+/* puts a copy of the cached hints to result and returns 1 if there are some */
+static int hint_cache_get(snd_config_t *config, unsigned int generation,
+			  snd_ctl_elem_iface_t iface, int card, void ***result)
+{
+	struct list_head *pos;
+	int err = 0;
+
+	hint_cache_lock();
+	if (config != hint_cache_config || generation != hint_cache_generation)
+		goto _unlock;
+	list_for_each(pos, &hint_cache_list) {
+		struct hint_cache *c = list_entry(pos, struct hint_cache, list);
+		if (c->iface == iface && c->card == card) {
+			*result = (void **)hint_copy(c->hints);
+			err = *result ? 1 : -ENOMEM;
+			break;
+		}
+	}
+ _unlock:
+	hint_cache_unlock();
+	return err;
+}
+
+static void hint_cache_flush(void)
+{
+	while (!list_empty(&hint_cache_list)) {
+		struct hint_cache *c = list_entry(hint_cache_list.next,
+						  struct hint_cache, list);
+		list_del(&c->list);
+		snd_device_name_free_hint((void **)c->hints);
+		free(c);
+	}
+	snd_config_unref(hint_cache_config);
+	hint_cache_config = NULL;
+}
+
+/* remembers a copy of hints, dropping the hints of other generations */
+static void hint_cache_put(snd_config_t *config, unsigned int generation,
+			   snd_ctl_elem_iface_t iface, int card, char **hints)
+{
+	struct hint_cache *c;
+	struct list_head *pos;
+
+	c = malloc(sizeof(*c));
+	if (c == NULL)
+		return;
+	c->iface = iface;
+	c->card = card;
+	c->hints = hint_copy(hints);
+	if (c->hints == NULL) {
+		free(c);
+		return;
+	}
+	hint_cache_lock();
+	if (config != hint_cache_config || generation != hint_cache_generation) {
+		hint_cache_flush();
+		snd_config_ref(config);
+		hint_cache_config = config;
+		hint_cache_generation = generation;
+	}
+	list_for_each(pos, &hint_cache_list) {
+		struct hint_cache *c1 = list_entry(pos, struct hint_cache, list);
+		if (c1->iface == iface && c1->card == card) {
+			hint_cache_unlock();
+			snd_device_name_free_hint((void **)c->hints);
+			free(c);
+			return;
+		}
+	}
+	list_add(&c->list, &hint_cache_list);
+	hint_cache_unlock();
+}
+
 static int hint_list_add(struct hint_list *list,
 			 const char *name,
 			 const char *description)
@@ -227,7 +358,7 @@ static int try_config(struct hint_list *list,
 		return -ENOMEM;
 	sprintf(buf, "%s.%s", base, name);
 	/* look for redirection */
-	if (snd_config_search(snd_config, buf, &cfg) >= 0 &&
+	if (snd_config_search(list->config, buf, &cfg) >= 0 &&
 	    snd_config_get_string(cfg, &str) >= 0 &&
 	    ((strncmp(base, str, strlen(base)) == 0 &&
 	     str[strlen(base)] == '.') || strchr(str, '.') == NULL))
@@ -240,7 +371,7 @@ static int try_config(struct hint_list *list,
 		strcpy(buf, name);
 	eh = snd_lib_error;
 	snd_lib_error_set_handler(&zero_handler);
-	err = snd_config_search_definition(snd_config, base, buf, &res);
+	err = snd_config_search_definition(list->config, base, buf, &res);
 	snd_lib_error_set_handler(eh);
 	if (err < 0)
 		goto __skip_add;
@@ -336,7 +467,7 @@ static int try_config(struct hint_list *list,
 	/* otherwise filter this definition */
 	eh = snd_lib_error;
 	snd_lib_error_set_handler(&zero_handler);
-	err = snd_config_search_alias_hooks(snd_config, base, buf, &res);
+	err = snd_config_search_alias_hooks(list->config, base, buf, &res);
 	snd_lib_error_set_handler(eh);
 	if (err < 0)
 		goto __cleanup;
@@ -414,7 +545,7 @@ static int add_card(struct hint_list *list, int card)
 	
 	snd_ctl_card_info_alloca(&info);
 	list->info = info;
-	err = snd_config_search(snd_config, list->siface, &conf);
+	err = snd_config_search(list->config, list->siface, &conf);
 	if (err < 0)
 		return err;
 	sprintf(ctl_name, "hw:%i", card);
@@ -502,6 +633,9 @@ static int get_card_name(struct hint_list *list, int card)
  *
  * Special variables: defaults.namehint.showall specifies if all device
  * definitions are accepted (boolean type).
+ *
+ * While the card list is cached (see #snd_card_next), the hints are
+ * cached too and rebuilt after a device or configuration change.
  */
 int snd_device_name_hint(int card, const char *iface, void ***hints)
 {
@@ -510,11 +644,12 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 	const char *str;
 	snd_config_t *conf;
 	snd_config_iterator_t i, next;
-	int err;
+	unsigned int generation;
+	int cached, err;
 
 	if (hints == NULL)
 		return -EINVAL;
-	err = snd_config_update();
+	err = snd_config_update_ref(&list.config);
 	if (err < 0)
 		return err;
 	list.list = NULL;
@@ -532,11 +667,22 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 		list.iface = SND_CTL_ELEM_IFACE_SEQUENCER;
 	else if (strcmp(iface, "hwdep") == 0)
 		list.iface = SND_CTL_ELEM_IFACE_HWDEP;
-	else
+	else {
+		snd_config_unref(list.config);
 		return -EINVAL;
+	}
+	cached = snd_card_cache_generation(&generation) >= 0;
+	if (cached) {
+		err = hint_cache_get(list.config, generation, list.iface,
+				     card, hints);
+		if (err != 0) {
+			snd_config_unref(list.config);
+			return err < 0 ? err : 0;
+		}
+	}
 	list.show_all = 0;
 	list.cardname = NULL;
-	if (snd_config_search(snd_config, "defaults.namehint.showall", &conf) >= 0)
+	if (snd_config_search(list.config, "defaults.namehint.showall", &conf) >= 0)
 		list.show_all = snd_config_get_bool(conf) > 0;
 	if (card >= 0) {
 		err = get_card_name(&list, card);
@@ -559,7 +705,7 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
 		}
 	}
 	sprintf(ehints, "namehint.%s", list.siface);
-	err = snd_config_search(snd_config, ehints, &conf);
+	err = snd_config_search(list.config, ehints, &conf);
 	if (err >= 0) {
 		snd_config_for_each(i, next, conf) {
 			if (snd_config_get_string(snd_config_iterator_entry(i),
@@ -576,6 +722,7 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
       		snd_device_name_free_hint((void **)list.list);
       		if (list.cardname)
 	      		free(list.cardname);
+		snd_config_unref(list.config);
       		return err;
       	} else {
       		err = hint_list_add(&list, NULL, NULL);
@@ -584,7 +731,11 @@ int snd_device_name_hint(int card, const char *iface, void ***hints)
       		*hints = (void **)list.list;
       		if (list.cardname)
 	      		free(list.cardname);
+		if (cached)
+			hint_cache_put(list.config, generation, list.iface,
+				       card, list.list);
 	}
+	snd_config_unref(list.config);
       	return 0;
 }
 
@@ -465,3 +465,252 @@ int snd_ctl_convert_from_dB(snd_ctl_t *ctl, const snd_ctl_elem_id_t *id,
 	return snd_tlv_convert_from_dB(info.tlv, info.minval, info.maxval,
 				       db_gain, value, xdir);
 }
+
+#ifndef DOC_HIDDEN
+/* largest raw range converted to dB through a lookup table */
+#define DB_TABLE_MAX		4096
+
+struct snd_tlv_db {
+	unsigned int *tlv;
+	long rangemin, rangemax;
+	int range_err;			/* of snd_tlv_get_dB_range() */
+	long dbmin, dbmax;
+	/* dB gain of each raw value in table_min..table_max */
+	long *table;
+	long table_min, table_max;
+#ifndef HAVE_SOFT_FLOAT
+	/* SND_CTL_TLVT_DB_LINEAR */
+	double lmin, lmax;
+	double vmin, vmax;
+#endif
+	/* SND_CTL_TLVT_DB_RANGE */
+	unsigned int count;
+	struct snd_tlv_db *ranges;
+};
+
+static void snd_tlv_db_done(struct snd_tlv_db *db)
+{
+	unsigned int idx;
+
+	for (idx = 0; idx < db->count; idx++)
+		snd_tlv_db_done(&db->ranges[idx]);
+	free(db->ranges);
+	free(db->table);
+}
+
+static int snd_tlv_db_init(struct snd_tlv_db *db, unsigned int *tlv,
+			   long rangemin, long rangemax)
+{
+	db->tlv = tlv;
+	db->rangemin = rangemin;
+	db->rangemax = rangemax;
+	db->range_err = snd_tlv_get_dB_range(tlv, rangemin, rangemax,
+					     &db->dbmin, &db->dbmax);
+	switch (tlv[0]) {
+	case SND_CTL_TLVT_DB_RANGE: {
+		unsigned int pos, len, count = 0;
+		int err;
+		len = int_index(tlv[1]);
+		if (len > MAX_TLV_RANGE_SIZE)
+			break;
+		for (pos = 2; pos + 4 <= len; pos += int_index(tlv[pos + 3]) + 4)
+			count++;
+		if (count == 0)
+			break;
+		db->ranges = calloc(count, sizeof(*db->ranges));
+		if (db->ranges == NULL)
+			return -ENOMEM;
+		for (pos = 2; pos + 4 <= len; pos += int_index(tlv[pos + 3]) + 4) {
+			err = snd_tlv_db_init(&db->ranges[db->count++], tlv + pos + 2,
+					      (int)tlv[pos], (int)tlv[pos + 1]);
+			if (err < 0)
+				return err;
+		}
+		break;
+	}
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR: {
+		int min = tlv[2];
+		int max = tlv[3];
+		db->lmin = pow(10.0, min/2000.0);
+		db->lmax = pow(10.0, max/2000.0);
+		db->vmin = (min <= SND_CTL_TLV_DB_GAIN_MUTE) ? 0.0 :
+			pow(10.0,  (double)min / 2000.0);
+		db->vmax = !max ? 1.0 : pow(10.0,  (double)max / 2000.0);
+		break;
+	}
+#endif
+	}
+	return 0;
+}
+
+static int snd_tlv_db_convert_to_dB(const struct snd_tlv_db *db, long volume,
+				    long *db_gain)
+{
+	unsigned int idx;
+
+	switch (db->tlv[0]) {
+	case SND_CTL_TLVT_DB_RANGE:
+		for (idx = 0; idx < db->count; idx++) {
+			const struct snd_tlv_db *r = &db->ranges[idx];
+			if (volume >= r->rangemin && volume <= r->rangemax)
+				return snd_tlv_db_convert_to_dB(r, volume, db_gain);
+		}
+		return -EINVAL;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR: {
+		int mindb = db->tlv[2];
+		int maxdb = db->tlv[3];
+		long rangemin = db->rangemin, rangemax = db->rangemax;
+		if (volume <= rangemin || rangemax <= rangemin)
+			*db_gain = mindb;
+		else if (volume >= rangemax)
+			*db_gain = maxdb;
+		else {
+			double val = (double)(volume - rangemin) /
+				(double)(rangemax - rangemin);
+			if (mindb <= SND_CTL_TLV_DB_GAIN_MUTE)
+				*db_gain = (long)(100.0 * 20.0 * log10(val)) +
+					maxdb;
+			else {
+				val = (db->lmax - db->lmin) * val + db->lmin;
+				*db_gain = (long)(100.0 * 20.0 * log10(val));
+			}
+		}
+		return 0;
+	}
+#endif
+	}
+	return snd_tlv_convert_to_dB(db->tlv, db->rangemin, db->rangemax,
+				     volume, db_gain);
+}
+
+static int snd_tlv_db_convert_from_dB(const struct snd_tlv_db *db, long db_gain,
+				      long *value, int xdir)
+{
+	unsigned int idx;
+
+	switch (db->tlv[0]) {
+	case SND_CTL_TLVT_DB_RANGE:
+		for (idx = 0; idx < db->count; idx++) {
+			const struct snd_tlv_db *r = &db->ranges[idx];
+			if (!r->range_err &&
+			    db_gain >= r->dbmin && db_gain <= r->dbmax)
+				return snd_tlv_db_convert_from_dB(r, db_gain,
+								  value, xdir);
+		}
+		return -EINVAL;
+#ifndef HAVE_SOFT_FLOAT
+	case SND_CTL_TLVT_DB_LINEAR: {
+		int min = db->tlv[2];
+		int max = db->tlv[3];
+		if (db_gain <= min)
+			*value = db->rangemin;
+		else if (db_gain >= max)
+			*value = db->rangemax;
+		else {
+			double v = pow(10.0, (double)db_gain / 2000.0);
+			v = (v - db->vmin) * (db->rangemax - db->rangemin) /
+				(db->vmax - db->vmin);
+			if (xdir > 0)
+				v = ceil(v);
+			*value = (long)v + db->rangemin;
+		}
+		return 0;
+	}
+#endif
+	}
+	return snd_tlv_convert_from_dB(db->tlv, db->rangemin, db->rangemax,
+				       db_gain, value, xdir);
+}
+
+/*
+ * Prepares the dB TLV returned by snd_tlv_parse_dB_info() for repeated
+ * conversions: the TLV is copied, the dB ranges and the constants of
+ * the linear scales are computed once, and the dB gain of each raw
+ * value is tabulated when the raw range is small enough.  The results
+ * are the same as the ones of the snd_tlv_*() functions.
+ */
+int snd_tlv_db_new(struct snd_tlv_db **dbp, unsigned int *tlv,
+		   long rangemin, long rangemax)
+{
+	struct snd_tlv_db *db;
+	unsigned int size = (int_index(tlv[1]) + 2) * sizeof(int);
+	long idx, count;
+	int err;
+
+	db = calloc(1, sizeof(*db));
+	if (db == NULL)
+		return -ENOMEM;
+	db->tlv = malloc(size);
+	if (db->tlv == NULL) {
+		free(db);
+		return -ENOMEM;
+	}
+	memcpy(db->tlv, tlv, size);
+	err = snd_tlv_db_init(db, db->tlv, rangemin, rangemax);
+	if (err < 0) {
+		snd_tlv_db_free(db);
+		return err;
+	}
+	if (db->tlv[0] == SND_CTL_TLVT_DB_RANGE && db->count > 0) {
+		rangemin = db->ranges[0].rangemin;
+		rangemax = db->ranges[0].rangemax;
+		for (idx = 1; idx < (long)db->count; idx++) {
+			if (db->ranges[idx].rangemin < rangemin)
+				rangemin = db->ranges[idx].rangemin;
+			if (db->ranges[idx].rangemax > rangemax)
+				rangemax = db->ranges[idx].rangemax;
+		}
+	}
+	count = rangemax - rangemin + 1;
+	if (count > 0 && count <= DB_TABLE_MAX) {
+		db->table = malloc(count * sizeof(*db->table));
+		for (idx = 0; db->table && idx < count; idx++) {
+			/* no table for values without a dB gain */
+			if (snd_tlv_db_convert_to_dB(db, rangemin + idx,
+						     &db->table[idx]) < 0) {
+				free(db->table);
+				db->table = NULL;
+			}
+		}
+		db->table_min = rangemin;
+		db->table_max = rangemax;
+	}
+	*dbp = db;
+	return 0;
+}
+
+void snd_tlv_db_free(struct snd_tlv_db *db)
+{
+	if (db == NULL)
+		return;
+	snd_tlv_db_done(db);
+	free(db->tlv);
+	free(db);
+}
+
+int snd_tlv_db_get_range(const struct snd_tlv_db *db, long *min, long *max)
+{
+	if (db->range_err < 0)
+		return db->range_err;
+	*min = db->dbmin;
+	*max = db->dbmax;
+	return 0;
+}
+
+int snd_tlv_db_to_dB(const struct snd_tlv_db *db, long volume, long *db_gain)
+{
+	if (db->table && volume >= db->table_min && volume <= db->table_max) {
+		*db_gain = db->table[volume - db->table_min];
+		return 0;
+	}
+	return snd_tlv_db_convert_to_dB(db, volume, db_gain);
+}
+
+int snd_tlv_db_from_dB(const struct snd_tlv_db *db, long db_gain, long *value,
+		       int xdir)
+{
+	return snd_tlv_db_convert_from_dB(db, db_gain, value, xdir);
+}
+#endif /* DOC_HIDDEN */
@@ -26,40 +26,61 @@ int bag_new(bag_t **bag)
 	bag_t *b = malloc(sizeof(*b));
 	if (!b)
 		return -ENOMEM;
-	INIT_LIST_HEAD(b);
+	bag_init(b);
 	*bag = b;
 	return 0;
 }
 
+void bag_init(bag_t *bag)
+{
+	bag->count = 0;
+	bag->alloc = BAG_INLINE;
+	bag->ptrs = bag->local;
+}
+
 void bag_free(bag_t *bag)
 {
-	assert(list_empty(bag));
+	assert(bag->count == 0);
 	free(bag);
 }
 
 int bag_empty(bag_t *bag)
 {
-	return list_empty(bag);
+	return bag->count == 0;
 }
 
 int bag_add(bag_t *bag, void *ptr)
 {
-	bag1_t *b = malloc(sizeof(*b));
-	if (!b)
-		return -ENOMEM;
-	b->ptr = ptr;
-	list_add_tail(&b->list, bag);
+	if (bag->count == bag->alloc) {
+		unsigned int alloc = bag->alloc * 2;
+		void **ptrs;
+		if (bag->ptrs == bag->local) {
+			ptrs = malloc(alloc * sizeof(*ptrs));
+			if (!ptrs)
+				return -ENOMEM;
+			memcpy(ptrs, bag->local, sizeof(bag->local));
+		} else {
+			ptrs = realloc(bag->ptrs, alloc * sizeof(*ptrs));
+			if (!ptrs)
+				return -ENOMEM;
+		}
+		bag->ptrs = ptrs;
+		bag->alloc = alloc;
+	}
+	bag->ptrs[bag->count++] = ptr;
 	return 0;
 }
 
 int bag_del(bag_t *bag, void *ptr)
 {
-	struct list_head *pos;
-	list_for_each(pos, bag) {
-		bag1_t *b = list_entry(pos, bag1_t, list);
-		if (b->ptr == ptr) {
-			list_del(&b->list);
-			free(b);
+	unsigned int i;
+	for (i = 0; i < bag->count; i++) {
+		if (bag->ptrs[i] == ptr) {
+			bag->count--;
+			memmove(bag->ptrs + i, bag->ptrs + i + 1,
+				(bag->count - i) * sizeof(*bag->ptrs));
+			if (bag->count == 0)
+				bag_del_all(bag);
 			return 0;
 		}
 	}
@@ -68,6 +89,7 @@ int bag_del(bag_t *bag, void *ptr)
 
 void bag_del_all(bag_t *bag)
 {
-	while (!list_empty(bag))
-		list_del(bag->next);
+	if (bag->ptrs != bag->local)
+		free(bag->ptrs);
+	bag_init(bag);
 }
@@ -46,6 +46,7 @@ This is an abstraction layer over the hcontrol layer.
 #include <fcntl.h>
 #include <sys/ioctl.h>
 #include "mixer_local.h"
+#include "mixer_simple.h"
 
 #ifndef DOC_HIDDEN
 typedef struct _snd_mixer_slave {
@@ -75,7 +76,9 @@ int snd_mixer_open(snd_mixer_t **mixerp, int mode ATTRIBUTE_UNUSED)
 	INIT_LIST_HEAD(&mixer->slaves);
 	INIT_LIST_HEAD(&mixer->classes);
 	INIT_LIST_HEAD(&mixer->elems);
+	INIT_LIST_HEAD(&mixer->pending);
 	mixer->compare = snd_mixer_compare_default;
+	mixer->seed = 0x2545f491;
 	*mixerp = mixer;
 	return 0;
 }
@@ -138,13 +141,16 @@ static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 	if (mask == SND_CTL_EVENT_MASK_REMOVE) {
 		int res = 0;
 		int err;
-		bag_iterator_t i, n;
-		bag_for_each_safe(i, n, bag) {
-			snd_mixer_elem_t *melem = bag_iterator_entry(i);
+		bag_iterator_t i = 0;
+		/* in the order of attaching, each event detaches its entry */
+		while (i < bag->count) {
+			snd_mixer_elem_t *melem = bag_iterator_entry(bag, i);
 			snd_mixer_class_t *class = melem->class;
 			err = class->event(class, mask, helem, melem);
 			if (err < 0)
 				res = err;
+			if (i < bag->count && bag_iterator_entry(bag, i) == melem)
+				i++;
 		}
 		assert(bag_empty(bag));
 		bag_free(bag);
@@ -152,13 +158,22 @@ static int hctl_elem_event_handler(snd_hctl_elem_t *helem,
 	}
 	if (mask & (SND_CTL_EVENT_MASK_VALUE | SND_CTL_EVENT_MASK_INFO)) {
 		int err = 0;
-		bag_iterator_t i, n;
-		bag_for_each_safe(i, n, bag) {
-			snd_mixer_elem_t *melem = bag_iterator_entry(i);
+		bag_iterator_t i = 0;
+		unsigned int left = bag->count;
+		/*
+		 * In the order of attaching.  An INFO event may detach the
+		 * current element and attach it again at the end, so only
+		 * advance past an unchanged entry and do not visit more
+		 * entries than there were.
+		 */
+		while (i < bag->count && left-- > 0) {
+			snd_mixer_elem_t *melem = bag_iterator_entry(bag, i);
 			snd_mixer_class_t *class = melem->class;
 			err = class->event(class, mask, helem, melem);
 			if (err < 0)
 				return err;
+			if (i < bag->count && bag_iterator_entry(bag, i) == melem)
+				i++;
 		}
 	}
 	return 0;
@@ -322,27 +337,174 @@ static int snd_mixer_elem_throw_event(snd_mixer_elem_t *elem, unsigned int mask)
 	return 0;
 }
 
-static int _snd_mixer_find_elem(snd_mixer_t *mixer, snd_mixer_elem_t *elem, int *dir)
+/*
+ * The elements are kept in compare order in a skip list, whose lowest
+ * level is the list of all elements, and the simple elements are hashed
+ * by name and index for snd_mixer_find_selem().
+ */
+#define MIXER_HASH_MIN	32
+
+static unsigned int snd_mixer_random_level(snd_mixer_t *mixer)
+{
+	unsigned int x = mixer->seed, level = 1;
+
+	/* xorshift32 */
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	mixer->seed = x;
+	/* one element of four is promoted to the next level */
+	while (level < MIXER_SKIP_MAX && (x & 3) == 0) {
+		level++;
+		x >>= 2;
+	}
+	return level;
+}
+
+/* the link at level lvl after x, x is NULL for the head */
+static inline snd_mixer_elem_t **snd_mixer_skip_link(snd_mixer_t *mixer,
+						     snd_mixer_elem_t *x,
+						     unsigned int lvl)
 {
-	unsigned int l, u;
-	int c = 0;
-	int idx = -1;
+	return x ? &x->skip[lvl] : &mixer->skip[lvl];
+}
+
+/*
+ * Returns the first element not less than elem, update receives the
+ * last element less than elem on each level.
+ */
+static snd_mixer_elem_t *snd_mixer_skip_search(snd_mixer_t *mixer,
+					       snd_mixer_elem_t *elem,
+					       snd_mixer_elem_t **update)
+{
+	snd_mixer_elem_t *x = NULL, *n;
+	int lvl;
+
 	assert(mixer && elem);
 	assert(mixer->compare);
-	l = 0;
-	u = mixer->count;
-	while (l < u) {
-		idx = (l + u) / 2;
-		c = mixer->compare(elem, mixer->pelems[idx]);
-		if (c < 0)
-			u = idx;
-		else if (c > 0)
-			l = idx + 1;
-		else
+	for (lvl = (int)mixer->level - 1; lvl >= 0; lvl--) {
+		while ((n = *snd_mixer_skip_link(mixer, x, lvl)) != NULL &&
+		       mixer->compare(elem, n) > 0)
+			x = n;
+		update[lvl] = x;
+	}
+	return *snd_mixer_skip_link(mixer, x, 0);
+}
+
+/* the predecessors are found by walking back the list */
+static void snd_mixer_skip_remove(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	struct list_head *pos = elem->list.prev;
+	snd_mixer_elem_t *x;
+	unsigned int lvl;
+
+	for (lvl = 0; lvl < elem->level; lvl++) {
+		while (pos != &mixer->elems &&
+		       list_entry(pos, snd_mixer_elem_t, list)->level <= lvl)
+			pos = pos->prev;
+		x = pos == &mixer->elems ? NULL : list_entry(pos, snd_mixer_elem_t, list);
+		*snd_mixer_skip_link(mixer, x, lvl) = elem->skip[lvl];
+	}
+	while (mixer->level > 0 && mixer->skip[mixer->level - 1] == NULL)
+		mixer->level--;
+	elem->level = 0;
+}
+
+static unsigned int snd_mixer_hash(snd_mixer_t *mixer, const snd_mixer_selem_id_t *id)
+{
+	const unsigned char *p = (const unsigned char *)id->name;
+	unsigned int h = 2166136261u;
+
+	while (*p)
+		h = (h ^ *p++) * 16777619u;
+	h = (h ^ id->index) * 16777619u;
+	return h & (mixer->hash_size - 1);
+}
+
+static inline const snd_mixer_selem_id_t *snd_mixer_elem_selem_id(snd_mixer_elem_t *elem)
+{
+	if (elem->type != SND_MIXER_ELEM_SIMPLE)
+		return NULL;
+	return ((sm_selem_t *)elem->private_data)->id;
+}
+
+static void snd_mixer_hash_link(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	const snd_mixer_selem_id_t *id = snd_mixer_elem_selem_id(elem);
+	unsigned int h;
+
+	if (id == NULL)
+		return;
+	h = snd_mixer_hash(mixer, id);
+	elem->hash_next = mixer->hash[h];
+	mixer->hash[h] = elem;
+}
+
+static void snd_mixer_hash_build(snd_mixer_t *mixer, unsigned int count)
+{
+	unsigned int size = MIXER_HASH_MIN;
+	struct list_head *pos;
+
+	while (size < count)
+		size <<= 1;
+	free(mixer->hash);
+	mixer->hash = calloc(size, sizeof(*mixer->hash));
+	if (mixer->hash == NULL) {
+		mixer->hash_size = 0;
+		return;
+	}
+	mixer->hash_size = size;
+	list_for_each(pos, &mixer->elems)
+		snd_mixer_hash_link(mixer, list_entry(pos, snd_mixer_elem_t, list));
+}
+
+static void snd_mixer_hash_remove(snd_mixer_t *mixer, snd_mixer_elem_t *elem)
+{
+	const snd_mixer_selem_id_t *id = snd_mixer_elem_selem_id(elem);
+	snd_mixer_elem_t **p;
+
+	if (!mixer->hash_size || id == NULL)
+		return;
+	for (p = &mixer->hash[snd_mixer_hash(mixer, id)]; *p; p = &(*p)->hash_next) {
+		if (*p == elem) {
+			*p = elem->hash_next;
 			break;
+		}
+	}
+}
+
+/*
+ * Returns the first simple element in the list with the given id, the
+ * list is scanned only when several elements share the id.
+ */
+snd_mixer_elem_t *snd_mixer_selem_lookup(snd_mixer_t *mixer,
+					 const snd_mixer_selem_id_t *id)
+{
+	snd_mixer_elem_t *elem, *found = NULL;
+	const snd_mixer_selem_id_t *eid;
+	struct list_head *pos;
+
+	if (!mixer->hash_size)
+		goto _scan;
+	elem = mixer->hash[snd_mixer_hash(mixer, id)];
+	for (; elem; elem = elem->hash_next) {
+		eid = snd_mixer_elem_selem_id(elem);
+		if (eid->index != id->index || strcmp(eid->name, id->name))
+			continue;
+		if (found)
+			break;
+		found = elem;
+	}
+	if (elem == NULL)
+		return found;
+ _scan:
+	list_for_each(pos, &mixer->elems) {
+		elem = list_entry(pos, snd_mixer_elem_t, list);
+		eid = snd_mixer_elem_selem_id(elem);
+		if (eid && eid->index == id->index && !strcmp(eid->name, id->name))
+			return elem;
 	}
-	*dir = c;
-	return idx;
+	return NULL;
 }
 
 /**
@@ -381,7 +543,7 @@ int snd_mixer_elem_new(snd_mixer_elem_t **elem,
 	melem->compare_weight = compare_weight;
 	melem->private_data = private_data;
 	melem->private_free = private_free;
-	INIT_LIST_HEAD(&melem->helems);
+	bag_init(&melem->helems);
 	*elem = melem;
 	return 0;
 }
@@ -396,38 +558,31 @@ int snd_mixer_elem_new(snd_mixer_elem_t **elem,
  */
 int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 {
-	int dir, idx;
+	snd_mixer_elem_t *update[MIXER_SKIP_MAX], **link;
+	snd_mixer_elem_t *next ATTRIBUTE_UNUSED;
 	snd_mixer_t *mixer = class->mixer;
+	unsigned int lvl, level;
 	elem->class = class;
 
-	if (mixer->count == mixer->alloc) {
-		snd_mixer_elem_t **m;
-		mixer->alloc += 32;
-		m = realloc(mixer->pelems, sizeof(*m) * mixer->alloc);
-		if (!m) {
-			mixer->alloc -= 32;
-			return -ENOMEM;
-		}
-		mixer->pelems = m;
-	}
-	if (mixer->count == 0) {
-		list_add_tail(&elem->list, &mixer->elems);
-		mixer->pelems[0] = elem;
-	} else {
-		idx = _snd_mixer_find_elem(mixer, elem, &dir);
-		assert(dir != 0);
-		if (dir > 0) {
-			list_add(&elem->list, &mixer->pelems[idx]->list);
-			idx++;
-		} else {
-			list_add_tail(&elem->list, &mixer->pelems[idx]->list);
-		}
-		memmove(mixer->pelems + idx + 1,
-			mixer->pelems + idx,
-			(mixer->count - idx) * sizeof(snd_mixer_elem_t *));
-		mixer->pelems[idx] = elem;
+	next = snd_mixer_skip_search(mixer, elem, update);
+	assert(next == NULL || mixer->compare(elem, next) != 0);
+	level = snd_mixer_random_level(mixer);
+	for (lvl = mixer->level; lvl < level; lvl++)
+		update[lvl] = NULL;
+	if (level > mixer->level)
+		mixer->level = level;
+	for (lvl = 0; lvl < level; lvl++) {
+		link = snd_mixer_skip_link(mixer, update[lvl], lvl);
+		elem->skip[lvl] = *link;
+		*link = elem;
 	}
+	elem->level = level;
+	list_add(&elem->list, update[0] ? &update[0]->list : &mixer->elems);
 	mixer->count++;
+	if (mixer->count > mixer->hash_size)
+		snd_mixer_hash_build(mixer, mixer->hash_size * 2);
+	else
+		snd_mixer_hash_link(mixer, elem);
 	return snd_mixer_throw_event(mixer, SND_CTL_EVENT_MASK_ADD, elem);
 }
 
@@ -441,27 +596,24 @@ int snd_mixer_elem_add(snd_mixer_elem_t *elem, snd_mixer_class_t *class)
 int snd_mixer_elem_remove(snd_mixer_elem_t *elem)
 {
 	snd_mixer_t *mixer = elem->class->mixer;
-	bag_iterator_t i, n;
-	int err, idx, dir;
-	unsigned int m;
+	bag_iterator_t i;
+	int err;
 	assert(elem);
 	assert(mixer->count);
-	idx = _snd_mixer_find_elem(mixer, elem, &dir);
-	if (dir != 0)
+	if (elem->level == 0)
 		return -EINVAL;
-	bag_for_each_safe(i, n, &elem->helems) {
-		snd_hctl_elem_t *helem = bag_iterator_entry(i);
+	for (i = elem->helems.count; i > 0; i--) {
+		snd_hctl_elem_t *helem = bag_iterator_entry(&elem->helems, i - 1);
 		snd_mixer_elem_detach(elem, helem);
 	}
 	err = snd_mixer_elem_throw_event(elem, SND_CTL_EVENT_MASK_REMOVE);
+	if (elem->write)
+		list_del(&elem->pending);
+	snd_mixer_hash_remove(mixer, elem);
+	snd_mixer_skip_remove(mixer, elem);
 	list_del(&elem->list);
 	snd_mixer_elem_free(elem);
 	mixer->count--;
-	m = mixer->count - idx;
-	if (m > 0)
-		memmove(mixer->pelems + idx,
-			mixer->pelems + idx + 1,
-			m * sizeof(snd_mixer_elem_t *));
 	return err;
 }
 
@@ -476,6 +628,7 @@ void snd_mixer_elem_free(snd_mixer_elem_t *elem)
 {
 	if (elem->private_free)
 		elem->private_free(elem);
+	bag_del_all(&elem->helems);
 	free(elem);
 }
 
@@ -543,11 +696,12 @@ int snd_mixer_class_register(snd_mixer_class_t *class, snd_mixer_t *mixer)
  */
 int snd_mixer_class_unregister(snd_mixer_class_t *class)
 {
-	unsigned int k;
+	struct list_head *pos, *prev;
 	snd_mixer_elem_t *e;
 	snd_mixer_t *mixer = class->mixer;
-	for (k = mixer->count; k > 0; k--) {
-		e = mixer->pelems[k-1];
+	for (pos = mixer->elems.prev; pos != &mixer->elems; pos = prev) {
+		prev = pos->prev;
+		e = list_entry(pos, snd_mixer_elem_t, list);
 		if (e->class == class)
 			snd_mixer_elem_remove(e);
 	}
@@ -607,8 +761,8 @@ int snd_mixer_close(snd_mixer_t *mixer)
 	}
 	assert(list_empty(&mixer->elems));
 	assert(mixer->count == 0);
-	free(mixer->pelems);
-	mixer->pelems = NULL;
+	free(mixer->hash);
+	mixer->hash = NULL;
 	while (!list_empty(&mixer->slaves)) {
 		int err;
 		snd_mixer_slave_t *s;
@@ -635,23 +789,60 @@ static int snd_mixer_compare_default(const snd_mixer_elem_t *c1,
 	return c1->class->compare(c1, c2);
 }
 
-static int mixer_compare(const void *a, const void *b)
+/* stable merge sort, tmp has room for n elements */
+static void snd_mixer_merge_sort(snd_mixer_t *mixer, snd_mixer_elem_t **a,
+				 snd_mixer_elem_t **tmp, unsigned int n)
 {
-	snd_mixer_t *mixer;
-
-	mixer = (*((const snd_mixer_elem_t * const *)a))->class->mixer;
-	return mixer->compare(*(const snd_mixer_elem_t * const *)a, *(const snd_mixer_elem_t * const *)b);
+	unsigned int h = n / 2, i = 0, j = h, k = 0;
+
+	if (n < 2)
+		return;
+	snd_mixer_merge_sort(mixer, a, tmp, h);
+	snd_mixer_merge_sort(mixer, a + h, tmp, n - h);
+	if (mixer->compare(a[h - 1], a[h]) <= 0)
+		return;
+	memcpy(tmp, a, n * sizeof(*a));
+	while (i < h && j < n)
+		a[k++] = mixer->compare(tmp[j], tmp[i]) < 0 ? tmp[j++] : tmp[i++];
+	while (i < h)
+		a[k++] = tmp[i++];
+	while (j < n)
+		a[k++] = tmp[j++];
 }
 
+/* sorts the list of elements and links the skip list along it */
 static int snd_mixer_sort(snd_mixer_t *mixer)
 {
-	unsigned int k;
+	snd_mixer_elem_t **a, **last[MIXER_SKIP_MAX];
+	struct list_head *pos;
+	unsigned int k, lvl;
+
 	assert(mixer);
 	assert(mixer->compare);
+	a = malloc((2 * mixer->count + 1) * sizeof(*a));
+	if (a == NULL)
+		return -ENOMEM;
+	k = 0;
+	list_for_each(pos, &mixer->elems)
+		a[k++] = list_entry(pos, snd_mixer_elem_t, list);
+	snd_mixer_merge_sort(mixer, a, a + mixer->count, mixer->count);
 	INIT_LIST_HEAD(&mixer->elems);
-	qsort(mixer->pelems, mixer->count, sizeof(snd_mixer_elem_t *), mixer_compare);
-	for (k = 0; k < mixer->count; k++)
-		list_add_tail(&mixer->pelems[k]->list, &mixer->elems);
+	for (lvl = 0; lvl < MIXER_SKIP_MAX; lvl++)
+		last[lvl] = &mixer->skip[lvl];
+	mixer->level = 0;
+	for (k = 0; k < mixer->count; k++) {
+		snd_mixer_elem_t *elem = a[k];
+		list_add_tail(&elem->list, &mixer->elems);
+		for (lvl = 0; lvl < elem->level; lvl++) {
+			*last[lvl] = elem;
+			last[lvl] = &elem->skip[lvl];
+		}
+		if (elem->level > mixer->level)
+			mixer->level = elem->level;
+	}
+	for (lvl = 0; lvl < MIXER_SKIP_MAX; lvl++)
+		*last[lvl] = NULL;
+	free(a);
 	return 0;
 }
 
@@ -851,6 +1042,74 @@ int snd_mixer_handle_events(snd_mixer_t *mixer)
 	return mixer->events;
 }
 
+/**
+ * \brief Start a transaction on a mixer
+ * \param mixer Mixer handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * Until #snd_mixer_commit is called, the simple element setters only
+ * update the element state. Each changed element is then written once,
+ * so a series of changes costs one write per control.
+ */
+int snd_mixer_begin(snd_mixer_t *mixer)
+{
+	assert(mixer);
+	if (mixer->transaction)
+		return -EBUSY;
+	mixer->transaction = 1;
+	return 0;
+}
+
+/**
+ * \brief Write the changes done since #snd_mixer_begin
+ * \param mixer Mixer handle
+ * \return 0 on success otherwise a negative error code
+ *
+ * The elements are written in the order they were first changed. A
+ * failed write does not stop the others, the last error is returned.
+ */
+int snd_mixer_commit(snd_mixer_t *mixer)
+{
+	int res = 0;
+	assert(mixer);
+	if (!mixer->transaction)
+		return -EINVAL;
+	mixer->transaction = 0;
+	while (!list_empty(&mixer->pending)) {
+		snd_mixer_elem_t *elem;
+		int (*write)(snd_mixer_elem_t *elem);
+		int err;
+		elem = list_entry(mixer->pending.next, snd_mixer_elem_t, pending);
+		write = elem->write;
+		list_del(&elem->pending);
+		elem->write = NULL;
+		err = write(elem);
+		if (err < 0)
+			res = err;
+	}
+	return res;
+}
+
+/**
+ * \brief Defer the write of an element to the transaction commit
+ * \param elem Mixer element
+ * \param write Function writing the element
+ * \return 1 if the write is deferred, 0 if it must be done now
+ *
+ * For use by mixer element class specific code.
+ */
+int snd_mixer_elem_defer(snd_mixer_elem_t *elem,
+			 int (*write)(snd_mixer_elem_t *elem))
+{
+	snd_mixer_t *mixer = elem->class->mixer;
+	if (!mixer->transaction)
+		return 0;
+	if (!elem->write)
+		list_add_tail(&elem->pending, &mixer->pending);
+	elem->write = write;
+	return 1;
+}
+
 /**
  * \brief Set callback function for a mixer
  * \param obj mixer handle
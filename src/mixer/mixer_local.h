@@ -22,25 +22,32 @@
 
 #include "local.h"
 
-typedef struct _bag1 {
-	void *ptr;
-	struct list_head list;
-} bag1_t;
+/*
+ * Bag of pointers: the first BAG_INLINE entries are kept in the bag
+ * itself, bigger bags move to an array growing in powers of two.
+ */
+#define BAG_INLINE	4
 
-typedef struct list_head bag_t;
+typedef struct _bag {
+	unsigned int count;
+	unsigned int alloc;
+	void **ptrs;			/* local or allocated array */
+	void *local[BAG_INLINE];
+} bag_t;
 
 int bag_new(bag_t **bag);
+void bag_init(bag_t *bag);
 void bag_free(bag_t *bag);
 int bag_add(bag_t *bag, void *ptr);
 int bag_del(bag_t *bag, void *ptr);
 int bag_empty(bag_t *bag);
 void bag_del_all(bag_t *bag);
 
-typedef struct list_head *bag_iterator_t;
+typedef unsigned int bag_iterator_t;
 
-#define bag_iterator_entry(i) (list_entry((i), bag1_t, list)->ptr)
-#define bag_for_each(pos, bag) list_for_each(pos, bag)
-#define bag_for_each_safe(pos, next, bag) list_for_each_safe(pos, next, bag)
+#define bag_iterator_entry(bag, i) ((bag)->ptrs[i])
+#define bag_for_each(pos, bag) \
+	for (pos = 0; pos < (bag)->count; pos++)
 
 struct _snd_mixer_class {
 	struct list_head list;
@@ -51,6 +58,8 @@ struct _snd_mixer_class {
 	snd_mixer_compare_t compare;
 };
 
+#define MIXER_SKIP_MAX	8
+
 struct _snd_mixer_elem {
 	snd_mixer_elem_type_t type;
 	struct list_head list;		/* links for list of all elems */
@@ -61,15 +70,25 @@ struct _snd_mixer_elem {
 	void *callback_private;
 	bag_t helems;
 	int compare_weight;		/* compare weight (reversed) */
+	snd_mixer_elem_t *hash_next;	/* next in the simple element hash chain */
+	unsigned int level;		/* number of skip list links, 0 if not added */
+	snd_mixer_elem_t *skip[MIXER_SKIP_MAX];	/* skip list links */
+	struct list_head pending;	/* link in the list of deferred writes */
+	int (*write)(snd_mixer_elem_t *elem);	/* deferred write, NULL if none */
 };
 
 struct _snd_mixer {
 	struct list_head slaves;	/* list of all slaves */
 	struct list_head classes;	/* list of all elem classes */
 	struct list_head elems;		/* list of all elems */
-	snd_mixer_elem_t **pelems;	/* array of all elems */
 	unsigned int count;
-	unsigned int alloc;
+	snd_mixer_elem_t *skip[MIXER_SKIP_MAX];	/* skip list heads */
+	unsigned int level;		/* levels in use */
+	unsigned int seed;		/* for the skip list levels */
+	unsigned int hash_size;		/* power of two, 0 if not hashed */
+	snd_mixer_elem_t **hash;	/* simple elements by name and index */
+	int transaction;		/* writes are deferred until commit */
+	struct list_head pending;	/* elems with deferred writes */
 	unsigned int events;
 	snd_mixer_callback_t callback;
 	void *callback_private;
@@ -80,3 +99,10 @@ struct _snd_mixer_selem_id {
 	char name[60];
 	unsigned int index;
 };
+
+/* make local functions really local */
+#define snd_mixer_selem_lookup \
+	snd1_mixer_selem_lookup
+
+snd_mixer_elem_t *snd_mixer_selem_lookup(snd_mixer_t *mixer,
+					 const snd_mixer_selem_id_t *id);
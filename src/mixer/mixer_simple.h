@@ -26,6 +26,9 @@
 	snd1_mixer_simple_none_register
 #define snd_mixer_simple_basic_register \
 	snd1_mixer_simple_basic_register
+#define snd_mixer_elem_defer \
+	snd1_mixer_elem_defer
 
 int snd_mixer_simple_none_register(snd_mixer_t *mixer, struct snd_mixer_selem_regopt *options, snd_mixer_class_t **classp);
 int snd_mixer_simple_basic_register(snd_mixer_t *mixer, struct snd_mixer_selem_regopt *options, snd_mixer_class_t **classp);
+int snd_mixer_elem_defer(snd_mixer_elem_t *elem, int (*write)(snd_mixer_elem_t *elem));
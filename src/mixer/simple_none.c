@@ -38,7 +38,7 @@
 #include <assert.h>
 #include <math.h>
 #include <limits.h>
-#include <alsa/asoundlib.h>
+#include "local.h"
 #include "mixer_simple.h"
 
 #ifndef DOC_HIDDEN
@@ -69,14 +69,18 @@ typedef struct _selem_ctl {
 	snd_hctl_elem_t *elem;
 	snd_ctl_elem_type_t type;
 	unsigned int inactive: 1;
+	unsigned int uncached: 1;	/* volatile, always read */
+	unsigned int value_valid: 1;
 	unsigned int values;
 	long min, max;
+	snd_ctl_elem_value_t *value;	/* last read value */
 } selem_ctl_t;
 
 typedef struct _selem_none {
 	sm_selem_t selem;
 	selem_ctl_t ctls[CTL_LAST + 1];
 	unsigned int capture_item;
+	unsigned int pending: 1;	/* write deferred to the commit */
 	struct selem_str {
 		unsigned int range: 1;	/* Forced range */
 		unsigned int db_initialized: 1;
@@ -85,7 +89,7 @@ typedef struct _selem_none {
 		unsigned int channels;
 		long vol[32];
 		unsigned int sw;
-		unsigned int *db_info;
+		struct snd_tlv_db *db;
 	} str[2];
 } selem_none_t;
 
@@ -231,14 +235,42 @@ static long from_user(selem_none_t *s, int dir, selem_ctl_t *c, long value)
 	return c->min + (n + (s->str[dir].max - s->str[dir].min) / 2) / (s->str[dir].max - s->str[dir].min);
 }
 
+/*
+ * The last value read from each backing control is kept, so an event
+ * for one control does not read all the others again.
+ */
+static int elem_read_value(selem_ctl_t *c, snd_ctl_elem_value_t **ctl)
+{
+	int err;
+
+	if (c->value == NULL) {
+		err = snd_ctl_elem_value_malloc(&c->value);
+		if (err < 0)
+			return err;
+	}
+	if (!c->value_valid || c->uncached) {
+		err = snd_hctl_elem_read(c->elem, c->value);
+		if (err < 0)
+			return err;
+		c->value_valid = 1;
+	}
+	*ctl = c->value;
+	return 0;
+}
+
+static int elem_write_value(selem_ctl_t *c, snd_ctl_elem_value_t *ctl)
+{
+	c->value_valid = 0;
+	return snd_hctl_elem_write(c->elem, ctl);
+}
+
 static int elem_read_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t *ctl;
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	snd_ctl_elem_value_alloca(&ctl);
-	if ((err = snd_hctl_elem_read(c->elem, ctl)) < 0)
+	if ((err = elem_read_value(c, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
@@ -255,8 +287,7 @@ static int elem_read_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	snd_ctl_elem_value_alloca(&ctl);
-	if ((err = snd_hctl_elem_read(c->elem, ctl)) < 0)
+	if ((err = elem_read_value(c, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
@@ -274,8 +305,7 @@ static int elem_read_route(selem_none_t *s, int dir, selem_ctl_type_t type)
 	unsigned int idx;
 	int err;
 	selem_ctl_t *c = &s->ctls[type];
-	snd_ctl_elem_value_alloca(&ctl);
-	if ((err = snd_hctl_elem_read(c->elem, ctl)) < 0)
+	if ((err = elem_read_value(c, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[dir].channels; idx++) {
 		unsigned int idx1 = idx;
@@ -302,8 +332,7 @@ static int elem_read_enum(selem_none_t *s)
 	else if (s->selem.caps & SM_CAP_CENUM)
 		type = CTL_CAPTURE_ENUM;
 	c = &s->ctls[type];
-	snd_ctl_elem_value_alloca(&ctl);
-	if ((err = snd_hctl_elem_read(c->elem, ctl)) < 0)
+	if ((err = elem_read_value(c, &ctl)) < 0)
 		return err;
 	for (idx = 0; idx < s->str[0].channels; idx++) {
 		unsigned int idx1 = idx;
@@ -314,7 +343,7 @@ static int elem_read_enum(selem_none_t *s)
 	return 0;
 }
 
-static int selem_read(snd_mixer_elem_t *elem)
+static int selem_refresh(snd_mixer_elem_t *elem)
 {
 	selem_none_t *s;
 	unsigned int idx;
@@ -441,8 +470,7 @@ static int selem_read(snd_mixer_elem_t *elem)
 	if (s->ctls[CTL_CAPTURE_SOURCE].elem) {
 		snd_ctl_elem_value_t *ctl;
 		selem_ctl_t *c = &s->ctls[CTL_CAPTURE_SOURCE];
-		snd_ctl_elem_value_alloca(&ctl);
-		err = snd_hctl_elem_read(c->elem, ctl);
+		err = elem_read_value(c, &ctl);
 		if (err < 0)
 			return err;
 		for (idx = 0; idx < s->str[SM_CAPT].channels; idx++) {
@@ -463,6 +491,16 @@ static int selem_read(snd_mixer_elem_t *elem)
 	return 0;
 }
 
+static int selem_read(snd_mixer_elem_t *elem)
+{
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
+	int k;
+
+	for (k = 0; k <= CTL_LAST; k++)
+		s->ctls[k].value_valid = 0;
+	return selem_refresh(elem);
+}
+
 static int elem_write_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
 {
 	snd_ctl_elem_value_t *ctl;
@@ -474,7 +512,7 @@ static int elem_write_volume(selem_none_t *s, int dir, selem_ctl_type_t type)
 		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(ctl, idx, from_user(s, dir, c, s->str[dir].vol[idx]));
-	if ((err = snd_hctl_elem_write(c->elem, ctl)) < 0)
+	if ((err = elem_write_value(c, ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -490,7 +528,7 @@ static int elem_write_switch(selem_none_t *s, int dir, selem_ctl_type_t type)
 		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(ctl, idx, !!(s->str[dir].sw & (1 << idx)));
-	if ((err = snd_hctl_elem_write(c->elem, ctl)) < 0)
+	if ((err = elem_write_value(c, ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -506,7 +544,7 @@ static int elem_write_switch_constant(selem_none_t *s, selem_ctl_type_t type, in
 		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(ctl, idx, !!val);
-	if ((err = snd_hctl_elem_write(c->elem, ctl)) < 0)
+	if ((err = elem_write_value(c, ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -524,7 +562,7 @@ static int elem_write_route(selem_none_t *s, int dir, selem_ctl_type_t type)
 		snd_ctl_elem_value_set_integer(ctl, idx, 0);
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_integer(ctl, idx * c->values + idx, !!(s->str[dir].sw & (1 << idx)));
-	if ((err = snd_hctl_elem_write(c->elem, ctl)) < 0)
+	if ((err = elem_write_value(c, ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -549,7 +587,7 @@ static int elem_write_enum(selem_none_t *s)
 		return err;
 	for (idx = 0; idx < c->values; idx++)
 		snd_ctl_elem_value_set_enumerated(ctl, idx, (unsigned int)s->str[0].vol[idx]);
-	if ((err = snd_hctl_elem_write(c->elem, ctl)) < 0)
+	if ((err = elem_write_value(c, ctl)) < 0)
 		return err;
 	return 0;
 }
@@ -633,7 +671,7 @@ static int selem_write_main(snd_mixer_elem_t *elem)
 			if (s->str[SM_CAPT].sw & (1 << idx))
 				snd_ctl_elem_value_set_enumerated(ctl, idx, s->capture_item);
 		}
-		if ((err = snd_hctl_elem_write(c->elem, ctl)) < 0)
+		if ((err = elem_write_value(c, ctl)) < 0)
 			return err;
 		/* update the element, don't remove */
 		err = selem_read(elem);
@@ -643,28 +681,70 @@ static int selem_write_main(snd_mixer_elem_t *elem)
 	return 0;
 }
 
-static int selem_write(snd_mixer_elem_t *elem)
+static int selem_flush(snd_mixer_elem_t *elem)
 {
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
 	int err;
 	
+	s->pending = 0;
 	err = selem_write_main(elem);
 	if (err < 0)
 		selem_read(elem);
 	return err;
 }
 
+static int selem_write(snd_mixer_elem_t *elem)
+{
+	selem_none_t *s = snd_mixer_elem_get_private(elem);
+
+	if (snd_mixer_elem_defer(elem, selem_flush)) {
+		s->pending = 1;
+		return 0;
+	}
+	return selem_flush(elem);
+}
+
 static void selem_free(snd_mixer_elem_t *elem)
 {
 	selem_none_t *simple = snd_mixer_elem_get_private(elem);
+	int k;
 	assert(snd_mixer_elem_get_type(elem) == SND_MIXER_ELEM_SIMPLE);
 	if (simple->selem.id)
 		snd_mixer_selem_id_free(simple->selem.id);
+	for (k = 0; k <= CTL_LAST; k++)
+		if (simple->ctls[k].value)
+			snd_ctl_elem_value_free(simple->ctls[k].value);
 	/* free db range information */
-	free(simple->str[0].db_info);
-	free(simple->str[1].db_info);
+	snd_tlv_db_free(simple->str[0].db);
+	snd_tlv_db_free(simple->str[1].db);
 	free(simple);
 }
 
+/* forget dB range information after the range or the TLV changed */
+static void reset_db_range(struct selem_str *rec)
+{
+	snd_tlv_db_free(rec->db);
+	rec->db = NULL;
+	rec->db_initialized = 0;
+	rec->db_init_error = 0;
+}
+
+/* sets the raw range found in the controls unless the range is forced */
+static void update_range(struct selem_str *rec, long min, long max)
+{
+	if (rec->range)
+		return;
+	if (min == LONG_MAX)
+		min = 0;
+	if (max == LONG_MIN)
+		max = 0;
+	if (rec->min != min || rec->max != max) {
+		rec->min = min;
+		rec->max = max;
+		reset_db_range(rec);
+	}
+}
+
 static int simple_update(snd_mixer_elem_t *melem)
 {
 	selem_none_t *simple;
@@ -872,15 +952,9 @@ static int simple_update(snd_mixer_elem_t *melem)
 
 	simple->selem.caps = caps;
 	simple->str[SM_PLAY].channels = pchannels;
-	if (!simple->str[SM_PLAY].range) {
-		simple->str[SM_PLAY].min = pmin != LONG_MAX ? pmin : 0;
-		simple->str[SM_PLAY].max = pmax != LONG_MIN ? pmax : 0;
-	}
+	update_range(&simple->str[SM_PLAY], pmin, pmax);
 	simple->str[SM_CAPT].channels = cchannels;
-	if (!simple->str[SM_CAPT].range) {
-		simple->str[SM_CAPT].min = cmin != LONG_MAX ? cmin : 0;
-		simple->str[SM_CAPT].max = cmax != LONG_MIN ? cmax : 0;
-	}
+	update_range(&simple->str[SM_CAPT], cmin, cmax);
 	return 0;
 }	   
 
@@ -1059,6 +1133,7 @@ static int set_range_ops(snd_mixer_elem_t *elem, int dir,
 	s->str[dir].range = 1;
 	s->str[dir].min = min;
 	s->str[dir].max = max;
+	reset_db_range(&s->str[dir]);
 	if ((err = selem_read(elem)) < 0)
 		return err;
 	return 0;
@@ -1083,8 +1158,7 @@ static int convert_to_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 {
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
-	return snd_tlv_convert_to_dB(rec->db_info, rec->min, rec->max,
-				     volume, db_gain);
+	return snd_tlv_db_to_dB(rec->db, volume, db_gain);
 }
 
 /* initialize dB range information, reading TLV via hcontrol
@@ -1115,10 +1189,8 @@ static int init_db_range(snd_hctl_elem_t *ctl, struct selem_str *rec)
 	db_size = snd_tlv_parse_dB_info(tlv, tlv_size, &dbrec);
 	if (db_size < 0)
 		goto error;
-	rec->db_info = malloc(db_size);
-	if (!rec->db_info)
+	if (snd_tlv_db_new(&rec->db, dbrec, rec->min, rec->max) < 0)
 		goto error;
-	memcpy(rec->db_info, dbrec, db_size);
 	free(tlv);
 	rec->db_initialized = 1;
 	return 0;
@@ -1155,7 +1227,7 @@ static int get_dB_range(snd_hctl_elem_t *ctl, struct selem_str *rec,
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
 
-	return snd_tlv_get_dB_range(rec->db_info, rec->min, rec->max, min, max);
+	return snd_tlv_db_get_range(rec->db, min, max);
 }
 	
 static int get_dB_range_ops(snd_mixer_elem_t *elem, int dir,
@@ -1178,8 +1250,7 @@ static int convert_from_dB(snd_hctl_elem_t *ctl, struct selem_str *rec,
 	if (init_db_range(ctl, rec) < 0)
 		return -EINVAL;
 
-	return snd_tlv_convert_from_dB(rec->db_info, rec->min, rec->max,
-				       db_gain, value, xdir);
+	return snd_tlv_db_from_dB(rec->db, db_gain, value, xdir);
 }
 
 static int ask_vol_dB_ops(snd_mixer_elem_t *elem,
@@ -1337,21 +1408,14 @@ static int get_enum_item_ops(snd_mixer_elem_t *elem,
 			     unsigned int *itemp)
 {
 	selem_none_t *s = snd_mixer_elem_get_private(elem);
-	snd_ctl_elem_value_t *ctl;
-	snd_hctl_elem_t *helem;
-	int err;
 
 	if ((unsigned int) channel >= s->str[0].channels)
 		return -EINVAL;
-	helem = s->ctls[CTL_GLOBAL_ENUM].elem;
-	if (!helem) helem = s->ctls[CTL_PLAYBACK_ENUM].elem;
-	if (!helem) helem = s->ctls[CTL_CAPTURE_ENUM].elem;
-	assert(helem);
-	snd_ctl_elem_value_alloca(&ctl);
-	err = snd_hctl_elem_read(helem, ctl);
-	if (! err)
-		*itemp = snd_ctl_elem_value_get_enumerated(ctl, channel);
-	return err;
+	assert(s->ctls[CTL_GLOBAL_ENUM].elem || s->ctls[CTL_PLAYBACK_ENUM].elem ||
+	       s->ctls[CTL_CAPTURE_ENUM].elem);
+	/* the state of selem_read(), including a change pending in a commit */
+	*itemp = s->str[0].vol[channel];
+	return 0;
 }
 
 static int set_enum_item_ops(snd_mixer_elem_t *elem,
@@ -1359,9 +1423,7 @@ static int set_enum_item_ops(snd_mixer_elem_t *elem,
 			     unsigned int item)
 {
 	selem_none_t *s = snd_mixer_elem_get_private(elem);
-	snd_ctl_elem_value_t *ctl;
 	snd_hctl_elem_t *helem;
-	int err;
 	int type;
 
 	if ((unsigned int) channel >= s->str[0].channels) {
@@ -1381,13 +1443,10 @@ static int set_enum_item_ops(snd_mixer_elem_t *elem,
 	if (item >= (unsigned int)s->ctls[type].max) {
 		return -EINVAL;
 	}
-	snd_ctl_elem_value_alloca(&ctl);
-	err = snd_hctl_elem_read(helem, ctl);
-	if (err < 0) {
-		return err;
-	}
-	snd_ctl_elem_value_set_enumerated(ctl, channel, item);
-	return snd_hctl_elem_write(helem, ctl);
+	if (s->str[0].vol[channel] == (long)item)
+		return 0;
+	s->str[0].vol[channel] = item;
+	return selem_write(elem);
 }
 
 static struct sm_elem_ops simple_none_ops = {
@@ -1549,6 +1608,8 @@ static int simple_add1(snd_mixer_class_t *class, const char *name,
 	simple->ctls[type].elem = helem;
 	simple->ctls[type].type = snd_ctl_elem_info_get_type(info);
 	simple->ctls[type].inactive = snd_ctl_elem_info_is_inactive(info);
+	simple->ctls[type].uncached = snd_ctl_elem_info_is_volatile(info);
+	simple->ctls[type].value_valid = 0;
 	simple->ctls[type].values = values;
 	if ( (type == CTL_GLOBAL_ENUM) ||
 	     (type == CTL_PLAYBACK_ENUM) ||
@@ -1655,6 +1716,7 @@ static int simple_event_remove(snd_hctl_elem_t *helem,
 	}
 	assert(k <= CTL_LAST);
 	simple->ctls[k].elem = NULL;
+	simple->ctls[k].value_valid = 0;
 	err = snd_mixer_elem_detach(melem, helem);
 	if (err < 0)
 		return err;
@@ -1676,6 +1738,9 @@ static int simple_event(snd_mixer_class_t *class, unsigned int mask,
 			return err;
 	}
 	if (mask & SND_CTL_EVENT_MASK_INFO) {
+		selem_none_t *simple = snd_mixer_elem_get_private(melem);
+		reset_db_range(&simple->str[SM_PLAY]);
+		reset_db_range(&simple->str[SM_CAPT]);
 		err = simple_event_remove(helem, melem);
 		if (err < 0)
 			return err;
@@ -1685,7 +1750,16 @@ static int simple_event(snd_mixer_class_t *class, unsigned int mask,
 		return 0;
 	}
 	if (mask & SND_CTL_EVENT_MASK_VALUE) {
-		err = selem_read(melem);
+		selem_none_t *simple = snd_mixer_elem_get_private(melem);
+		int k;
+		/* only the changed control is read again */
+		for (k = 0; k <= CTL_LAST; k++)
+			if (simple->ctls[k].elem == helem)
+				simple->ctls[k].value_valid = 0;
+		/* keep the state to be written on commit */
+		if (simple->pending)
+			return 0;
+		err = selem_refresh(melem);
 		if (err < 0)
 			return err;
 		if (err) {
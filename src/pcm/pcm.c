@@ -2233,12 +2233,15 @@ static int snd_pcm_open_noupdate(snd_pcm_t **pcmp, snd_config_t *root,
 int snd_pcm_open(snd_pcm_t **pcmp, const char *name, 
 		 snd_pcm_stream_t stream, int mode)
 {
+	snd_config_t *top;
 	int err;
 	assert(pcmp && name);
-	err = snd_config_update();
+	err = snd_config_update_ref(&top);
 	if (err < 0)
 		return err;
-	return snd_pcm_open_noupdate(pcmp, snd_config, name, stream, mode, 0);
+	err = snd_pcm_open_noupdate(pcmp, top, name, stream, mode, 0);
+	snd_config_unref(top);
+	return err;
 }
 
 /**
@@ -2508,15 +2511,8 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
 	width = snd_pcm_format_physical_width(format);
 	silence = snd_pcm_format_silence_64(format);
-	if (dst_area->step == (unsigned int) width) {
-		unsigned int dwords = samples * width / 64;
-		u_int64_t *dstp = (u_int64_t *)dst;
-		samples -= dwords * 64 / width;
-		while (dwords-- > 0)
-			*dstp++ = silence;
-		if (samples == 0)
-			return 0;
-	}
+	if (dst_area->step == (unsigned int) width && width % 8 == 0)
+		return snd_pcm_format_set_silence(format, dst, samples);
 	dst_step = dst_area->step / 8;
 	switch (width) {
 	case 4: {
@@ -2558,15 +2554,18 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 		break;
 	}
 	case 24:
+		while (samples-- > 0) {
 #ifdef SNDRV_LITTLE_ENDIAN
-		*(dst + 0) = silence >> 0;
-		*(dst + 1) = silence >> 8;
-		*(dst + 2) = silence >> 16;
+			*(dst + 0) = silence >> 0;
+			*(dst + 1) = silence >> 8;
+			*(dst + 2) = silence >> 16;
 #else
-		*(dst + 2) = silence >> 0;
-		*(dst + 1) = silence >> 8;
-		*(dst + 0) = silence >> 16;
+			*(dst + 2) = silence >> 0;
+			*(dst + 1) = silence >> 8;
+			*(dst + 0) = silence >> 16;
 #endif
+			dst += dst_step;
+		}
 		break;
 	case 32: {
 		u_int32_t sil = silence;
@@ -2590,6 +2589,59 @@ int snd_pcm_area_silence(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/*
+ * Silence a run of adjacent channels inside an interleaved buffer:
+ * the silence of all chns samples of a frame is stored at once.
+ */
+static int snd_pcm_area_silence_group(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t dst_offset,
+				      unsigned int chns, snd_pcm_uframes_t frames, snd_pcm_format_t format)
+{
+	u_int64_t pat[4];
+	unsigned int bytes = chns * snd_pcm_format_physical_width(format) / 8;
+	unsigned int dst_step = dst_area->step / 8;
+	char *dst;
+
+	if (bytes > sizeof(pat))
+		return -EINVAL;
+	snd_pcm_format_set_silence(format, pat, chns);
+	dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
+	switch (bytes) {
+	case 2:
+		while (frames-- > 0) {
+			memcpy(dst, pat, 2);
+			dst += dst_step;
+		}
+		break;
+	case 4:
+		while (frames-- > 0) {
+			memcpy(dst, pat, 4);
+			dst += dst_step;
+		}
+		break;
+	case 8:
+		while (frames-- > 0) {
+			memcpy(dst, pat, 8);
+			dst += dst_step;
+		}
+		break;
+	case 16:
+		while (frames-- > 0) {
+			memcpy(dst, pat, 16);
+			dst += dst_step;
+		}
+		break;
+	default:
+		while (frames-- > 0) {
+			memcpy(dst, pat, bytes);
+			dst += dst_step;
+		}
+		break;
+	}
+	return 0;
+}
+#endif
+
 /**
  * \brief Silence one or more areas
  * \param dst_areas areas specification (one for each channel)
@@ -2628,6 +2680,11 @@ int snd_pcm_areas_silence(const snd_pcm_channel_area_t *dst_areas, snd_pcm_ufram
 			d.step = width;
 			err = snd_pcm_area_silence(&d, dst_offset * chns, frames * chns, format);
 			channels -= chns;
+		} else if (chns > 1 && width % 8 == 0 && begin->first % 8 == 0 &&
+			   step % 8 == 0 && begin->addr &&
+			   snd_pcm_area_silence_group(begin, dst_offset, chns, frames, format) == 0) {
+			err = 0;
+			channels -= chns;
 		} else {
 			err = snd_pcm_area_silence(begin, dst_offset, frames, format);
 			dst_areas = begin + 1;
@@ -2758,6 +2815,163 @@ int snd_pcm_area_copy(const snd_pcm_channel_area_t *dst_area, snd_pcm_uframes_t
 	return 0;
 }
 
+#ifndef DOC_HIDDEN
+/* 3-byte sample container for the packed 24-bit transposers */
+typedef struct {
+	u_int8_t b[3];
+} snd_pcm_sample24_t;
+
+/*
+ * Interleave / deinterleave kernels. The _n variants are inlined with a
+ * constant channel count for the common layouts, so the compiler can
+ * unroll the per-frame loop and turn it into vector shuffles.
+ */
+#define DEFINE_AREAS_TRANSPOSE(type, suffix)				\
+static inline void interleave_##suffix##_n(type *dst, type * const *src,	\
+					   unsigned int channels,	\
+					   snd_pcm_uframes_t frames)	\
+{									\
+	snd_pcm_uframes_t f;						\
+	unsigned int c;							\
+	for (f = 0; f < frames; f++)					\
+		for (c = 0; c < channels; c++)				\
+			*dst++ = src[c][f];				\
+}									\
+static inline void deinterleave_##suffix##_n(type * const *dst, const type *src, \
+					     unsigned int channels,	\
+					     snd_pcm_uframes_t frames)	\
+{									\
+	snd_pcm_uframes_t f;						\
+	unsigned int c;							\
+	for (f = 0; f < frames; f++)					\
+		for (c = 0; c < channels; c++)				\
+			dst[c][f] = *src++;				\
+}									\
+static void interleave_##suffix(void *dst, void * const *src,		\
+				unsigned int channels,			\
+				snd_pcm_uframes_t frames)		\
+{									\
+	type * const *s = (type * const *)src;				\
+	switch (channels) {						\
+	case 2: interleave_##suffix##_n(dst, s, 2, frames); break;	\
+	case 4: interleave_##suffix##_n(dst, s, 4, frames); break;	\
+	case 6: interleave_##suffix##_n(dst, s, 6, frames); break;	\
+	case 8: interleave_##suffix##_n(dst, s, 8, frames); break;	\
+	default: interleave_##suffix##_n(dst, s, channels, frames); break; \
+	}								\
+}									\
+static void deinterleave_##suffix(void * const *dst, const void *src,	\
+				  unsigned int channels,		\
+				  snd_pcm_uframes_t frames)		\
+{									\
+	type * const *d = (type * const *)dst;				\
+	switch (channels) {						\
+	case 2: deinterleave_##suffix##_n(d, src, 2, frames); break;	\
+	case 4: deinterleave_##suffix##_n(d, src, 4, frames); break;	\
+	case 6: deinterleave_##suffix##_n(d, src, 6, frames); break;	\
+	case 8: deinterleave_##suffix##_n(d, src, 8, frames); break;	\
+	default: deinterleave_##suffix##_n(d, src, channels, frames); break; \
+	}								\
+}
+
+DEFINE_AREAS_TRANSPOSE(u_int8_t, 8)
+DEFINE_AREAS_TRANSPOSE(u_int16_t, 16)
+DEFINE_AREAS_TRANSPOSE(snd_pcm_sample24_t, 24)
+DEFINE_AREAS_TRANSPOSE(u_int32_t, 32)
+DEFINE_AREAS_TRANSPOSE(u_int64_t, 64)
+
+/* Does areas describe a single byte aligned interleaved buffer? */
+int snd_pcm_areas_interleaved(const snd_pcm_channel_area_t *areas,
+			      unsigned int channels, int width)
+{
+	unsigned int c;
+	if (!areas->addr || areas->first % 8 ||
+	    areas->step != channels * width)
+		return 0;
+	for (c = 1; c < channels; c++) {
+		if (areas[c].addr != areas->addr ||
+		    areas[c].step != areas->step ||
+		    areas[c].first != areas->first + c * width)
+			return 0;
+	}
+	return 1;
+}
+
+/* Are all areas byte aligned and non-interleaved? */
+static int areas_planar(const snd_pcm_channel_area_t *areas,
+			unsigned int channels, int width)
+{
+	unsigned int c;
+	for (c = 0; c < channels; c++) {
+		if (!areas[c].addr || areas[c].first % 8 ||
+		    areas[c].step != (unsigned int) width)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+ * Fast path for snd_pcm_areas_copy(): interleaved <-> non-interleaved
+ * transposition. Returns 1 when the copy was done, 0 when the layout
+ * is not handled here.
+ */
+static int snd_pcm_areas_transpose(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+				   const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+				   unsigned int channels, snd_pcm_uframes_t frames, int width)
+{
+	void (*interleave)(void *, void * const *, unsigned int, snd_pcm_uframes_t);
+	void (*deinterleave)(void * const *, const void *, unsigned int, snd_pcm_uframes_t);
+	void **planes;
+	unsigned int c;
+
+	switch (width) {
+	case 8:
+		interleave = interleave_8;
+		deinterleave = deinterleave_8;
+		break;
+	case 16:
+		interleave = interleave_16;
+		deinterleave = deinterleave_16;
+		break;
+	case 24:
+		interleave = interleave_24;
+		deinterleave = deinterleave_24;
+		break;
+	case 32:
+		interleave = interleave_32;
+		deinterleave = deinterleave_32;
+		break;
+	case 64:
+		interleave = interleave_64;
+		deinterleave = deinterleave_64;
+		break;
+	default:
+		return 0;
+	}
+	if (channels < 2 || src_areas->addr == dst_areas->addr)
+		return 0;
+	if (snd_pcm_areas_interleaved(dst_areas, channels, width) &&
+	    areas_planar(src_areas, channels, width)) {
+		planes = alloca(channels * sizeof(*planes));
+		for (c = 0; c < channels; c++)
+			planes[c] = snd_pcm_channel_area_addr(&src_areas[c], src_offset);
+		interleave(snd_pcm_channel_area_addr(dst_areas, dst_offset),
+			   planes, channels, frames);
+		return 1;
+	}
+	if (snd_pcm_areas_interleaved(src_areas, channels, width) &&
+	    areas_planar(dst_areas, channels, width)) {
+		planes = alloca(channels * sizeof(*planes));
+		for (c = 0; c < channels; c++)
+			planes[c] = snd_pcm_channel_area_addr(&dst_areas[c], dst_offset);
+		deinterleave(planes, snd_pcm_channel_area_addr(src_areas, src_offset),
+			     channels, frames);
+		return 1;
+	}
+	return 0;
+}
+#endif
+
 /**
  * \brief Copy one or more areas
  * \param dst_areas destination areas specification (one for each channel)
@@ -2784,6 +2998,9 @@ int snd_pcm_areas_copy(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_
 		SNDMSG("invalid frames %ld", frames);
 		return -EINVAL;
 	}
+	if (snd_pcm_areas_transpose(dst_areas, dst_offset, src_areas, src_offset,
+				    channels, frames, width))
+		return 0;
 	while (channels > 0) {
 		unsigned int step = src_areas->step;
 		void *src_addr = src_areas->addr;
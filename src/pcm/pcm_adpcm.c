@@ -57,6 +57,7 @@ IMA compatibility project proceedings, Vol 2, Issue 2, May 1992.
  */
 
 #include <byteswap.h>
+#include <pthread.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -104,7 +105,40 @@ static const short StepSize[89] = {
 	15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
 };
 
-static char adpcm_encoder(int sl, snd_pcm_adpcm_state_t * state)
+/*
+ * Predicted difference and next StepSize index for every
+ * (StepSize index, code magnitude) pair, filled on first use.
+ * pred_diff is kept as short to preserve the original wrap-around.
+ */
+static short PredDiff[89][8];
+static unsigned char NextIndex[89][8];
+static pthread_once_t adpcm_tables_once = PTHREAD_ONCE_INIT;
+
+static void adpcm_tables_init(void)
+{
+	int idx, code, i;
+
+	for (idx = 0; idx < 89; idx++) {
+		for (code = 0; code < 8; code++) {
+			short step = StepSize[idx];
+			short pred_diff = step >> 3;
+			int next;
+			for (i = 0x4; i; i >>= 1, step >>= 1) {
+				if (code & i)
+					pred_diff += step;
+			}
+			PredDiff[idx][code] = pred_diff;
+			next = idx + IndexAdjust[code];
+			if (next < 0)
+				next = 0;
+			else if (next > 88)
+				next = 88;
+			NextIndex[idx][code] = next;
+		}
+	}
+}
+
+static inline char adpcm_encoder(int sl, snd_pcm_adpcm_state_t * state)
 {
 	short diff;		/* Difference between sl and predicted sample */
 	short pred_diff;	/* Predicted difference to next sample */
@@ -135,14 +169,13 @@ static char adpcm_encoder(int sl, snd_pcm_adpcm_state_t * state)
 	step = StepSize[state->step_idx];
 
 	/* Divide and clamp */
-	pred_diff = step >> 3;
 	for (adjust_idx = 0, i = 0x4; i; i >>= 1, step >>= 1) {
 		if (diff >= step) {
 			adjust_idx |= i;
 			diff -= step;
-			pred_diff += step;
 		}
 	}
+	pred_diff = PredDiff[state->step_idx][adjust_idx];
 
 	/* Update and clamp previous predicted value */
 	state->pred_val += sign ? -pred_diff : pred_diff;
@@ -153,45 +186,22 @@ static char adpcm_encoder(int sl, snd_pcm_adpcm_state_t * state)
 		state->pred_val = -32768;
 	}
 
-	/* Update and clamp StepSize lookup table index */
-	state->step_idx += IndexAdjust[adjust_idx];
-
-	if (state->step_idx < 0) {
-		state->step_idx = 0;
-	} else if (state->step_idx > 88) {
-		state->step_idx = 88;
-	}
+	/* Update StepSize lookup table index */
+	state->step_idx = NextIndex[state->step_idx][adjust_idx];
 	return (sign | adjust_idx);
 }
 
 
-static int adpcm_decoder(unsigned char code, snd_pcm_adpcm_state_t * state)
+static inline int adpcm_decoder(unsigned char code, snd_pcm_adpcm_state_t * state)
 {
 	short pred_diff;	/* Predicted difference to next sample */
-	short step;		/* holds previous StepSize value */
-	char sign;
-
-	int i;
-
-	/* Separate sign and magnitude */
-	sign = code & 0x8;
-	code &= 0x7;
 
 	/*
 	 * Computes pred_diff = (code + 0.5) * step / 4,
 	 * but see comment in adpcm_coder.
 	 */
-
-	step = StepSize[state->step_idx];
-
-	/* Compute difference and new predicted value */
-	pred_diff = step >> 3;
-	for (i = 0x4; i; i >>= 1, step >>= 1) {
-		if (code & i) {
-			pred_diff += step;
-		}
-	}
-	state->pred_val += (sign) ? -pred_diff : pred_diff;
+	pred_diff = PredDiff[state->step_idx][code & 0x7];
+	state->pred_val += (code & 0x8) ? -pred_diff : pred_diff;
 
 	/* Clamp output value */
 	if (state->pred_val > 32767) {
@@ -201,14 +211,113 @@ static int adpcm_decoder(unsigned char code, snd_pcm_adpcm_state_t * state)
 	}
 
 	/* Find new StepSize index value */
-	state->step_idx += IndexAdjust[code];
+	state->step_idx = NextIndex[state->step_idx][code & 0x7];
+	return (state->pred_val);
+}
 
-	if (state->step_idx < 0) {
-		state->step_idx = 0;
-	} else if (state->step_idx > 88) {
-		state->step_idx = 88;
+/*
+ * Decode frame by frame when both sides are interleaved, the ADPCM
+ * stream is byte aligned with an even channel count and the output is
+ * host endian S16. Each source byte carries two adjacent channels.
+ */
+static int adpcm_decode_interleaved(const snd_pcm_channel_area_t *dst_areas,
+				    snd_pcm_uframes_t dst_offset,
+				    const snd_pcm_channel_area_t *src_areas,
+				    snd_pcm_uframes_t src_offset,
+				    unsigned int channels, snd_pcm_uframes_t frames,
+				    snd_pcm_adpcm_state_t *states)
+{
+	const unsigned char *src;
+	int16_t *dst;
+	unsigned int channel;
+
+	if (channels % 2 || src_areas->step != channels * 4 ||
+	    dst_areas->step != channels * 16 ||
+	    (src_areas->first + src_areas->step * src_offset) % 8 ||
+	    dst_areas->first % 16)
+		return 0;
+	for (channel = 1; channel < channels; channel++) {
+		if (src_areas[channel].addr != src_areas->addr ||
+		    src_areas[channel].step != src_areas->step ||
+		    src_areas[channel].first != src_areas->first + channel * 4 ||
+		    dst_areas[channel].addr != dst_areas->addr ||
+		    dst_areas[channel].step != dst_areas->step ||
+		    dst_areas[channel].first != dst_areas->first + channel * 16)
+			return 0;
+	}
+	src = snd_pcm_channel_area_addr(src_areas, src_offset);
+	dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+	while (frames-- > 0) {
+		for (channel = 0; channel < channels; channel += 2) {
+			unsigned char v = *src++;
+			*dst++ = adpcm_decoder(v >> 4, &states[channel]);
+			*dst++ = adpcm_decoder(v & 0x0f, &states[channel + 1]);
+		}
+	}
+	return 1;
+}
+
+/*
+ * Encode frame by frame under the same conditions, from host endian
+ * S16 into a byte aligned ADPCM stream.
+ */
+static int adpcm_encode_interleaved(const snd_pcm_channel_area_t *dst_areas,
+				    snd_pcm_uframes_t dst_offset,
+				    const snd_pcm_channel_area_t *src_areas,
+				    snd_pcm_uframes_t src_offset,
+				    unsigned int channels, snd_pcm_uframes_t frames,
+				    snd_pcm_adpcm_state_t *states)
+{
+	const int16_t *src;
+	unsigned char *dst;
+	unsigned int channel;
+
+	if (channels % 2 || dst_areas->step != channels * 4 ||
+	    src_areas->step != channels * 16 ||
+	    (dst_areas->first + dst_areas->step * dst_offset) % 8 ||
+	    src_areas->first % 16)
+		return 0;
+	for (channel = 1; channel < channels; channel++) {
+		if (dst_areas[channel].addr != dst_areas->addr ||
+		    dst_areas[channel].step != dst_areas->step ||
+		    dst_areas[channel].first != dst_areas->first + channel * 4 ||
+		    src_areas[channel].addr != src_areas->addr ||
+		    src_areas[channel].step != src_areas->step ||
+		    src_areas[channel].first != src_areas->first + channel * 16)
+			return 0;
+	}
+	src = snd_pcm_channel_area_addr(src_areas, src_offset);
+	dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+	while (frames-- > 0) {
+		for (channel = 0; channel < channels; channel += 2) {
+			unsigned char v;
+			v = adpcm_encoder(*src++, &states[channel]) << 4;
+			v |= adpcm_encoder(*src++, &states[channel + 1]);
+			*dst++ = v;
+		}
+	}
+	return 1;
+}
+
+/* native S16 input, one channel: no conversion labels */
+static void adpcm_encode_s16(char *dst, int dstbit, int dst_step, int dstbit_step,
+			     const char *src, int src_step,
+			     snd_pcm_uframes_t frames, snd_pcm_adpcm_state_t *state)
+{
+	while (frames-- > 0) {
+		int v = adpcm_encoder(*(const int16_t *)src, state);
+		if (dstbit)
+			*dst = (*dst & 0xf0) | v;
+		else
+			*dst = (*dst & 0x0f) | (v << 4);
+		src += src_step;
+		dst += dst_step;
+		dstbit += dstbit_step;
+		if (dstbit == 8) {
+			dst++;
+			dstbit = 0;
+		}
 	}
-	return (state->pred_val);
 }
 
 #ifndef DOC_HIDDEN
@@ -226,12 +335,18 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
 	unsigned int channel;
+	pthread_once(&adpcm_tables_once, adpcm_tables_init);
+	if (putidx == SND_PCM_LINEAR_S16_INDEX &&
+	    adpcm_decode_interleaved(dst_areas, dst_offset, src_areas, src_offset,
+				     channels, frames, states))
+		return;
 	for (channel = 0; channel < channels; ++channel, ++states) {
 		const char *src;
 		int srcbit;
 		char *dst;
 		int src_step, srcbit_step, dst_step;
 		snd_pcm_uframes_t frames1;
+		snd_pcm_adpcm_state_t state = *states;
 		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
 		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
 		srcbit = src_area->first + src_area->step * src_offset;
@@ -242,6 +357,26 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		frames1 = frames;
+		if (putidx == SND_PCM_LINEAR_S16_INDEX) {
+			/* native S16: no conversion labels */
+			while (frames1-- > 0) {
+				unsigned char v;
+				if (srcbit)
+					v = *src & 0x0f;
+				else
+					v = (*src >> 4) & 0x0f;
+				*(int16_t *)dst = adpcm_decoder(v, &state);
+				src += src_step;
+				srcbit += srcbit_step;
+				if (srcbit == 8) {
+					src++;
+					srcbit = 0;
+				}
+				dst += dst_step;
+			}
+			*states = state;
+			continue;
+		}
 		while (frames1-- > 0) {
 			int16_t sample;
 			unsigned char v;
@@ -249,7 +384,7 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 				v = *src & 0x0f;
 			else
 				v = (*src >> 4) & 0x0f;
-			sample = adpcm_decoder(v, states);
+			sample = adpcm_decoder(v, &state);
 			goto *put;
 #define PUT16_END after
 #include "plugin_ops.h"
@@ -263,6 +398,7 @@ void snd_pcm_adpcm_decode(const snd_pcm_channel_area_t *dst_areas,
 			}
 			dst += dst_step;
 		}
+		*states = state;
 	}
 }
 
@@ -280,12 +416,18 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 	void *get = get16_labels[getidx];
 	unsigned int channel;
 	int16_t sample = 0;
+	pthread_once(&adpcm_tables_once, adpcm_tables_init);
+	if (getidx == SND_PCM_LINEAR_S16_INDEX &&
+	    adpcm_encode_interleaved(dst_areas, dst_offset, src_areas, src_offset,
+				     channels, frames, states))
+		return;
 	for (channel = 0; channel < channels; ++channel, ++states) {
 		const char *src;
 		char *dst;
 		int dstbit;
 		int src_step, dst_step, dstbit_step;
 		snd_pcm_uframes_t frames1;
+		snd_pcm_adpcm_state_t state = *states;
 		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
 		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
 		src = snd_pcm_channel_area_addr(src_area, src_offset);
@@ -296,6 +438,12 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 		dst_step = dst_area->step / 8;
 		dstbit_step = dst_area->step % 8;
 		frames1 = frames;
+		if (getidx == SND_PCM_LINEAR_S16_INDEX) {
+			adpcm_encode_s16(dst, dstbit, dst_step, dstbit_step,
+					 src, src_step, frames, &state);
+			*states = state;
+			continue;
+		}
 		while (frames1-- > 0) {
 			int v;
 			goto *get;
@@ -303,7 +451,7 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 #include "plugin_ops.h"
 #undef GET16_END
 		after:
-			v = adpcm_encoder(sample, states);
+			v = adpcm_encoder(sample, &state);
 			if (dstbit)
 				*dst = (*dst & 0xf0) | v;
 			else
@@ -316,6 +464,7 @@ void snd_pcm_adpcm_encode(const snd_pcm_channel_area_t *dst_areas,
 				dstbit = 0;
 			}
 		}
+		*states = state;
 	}
 }
 
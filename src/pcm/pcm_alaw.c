@@ -27,6 +27,7 @@
  */
   
 #include <byteswap.h>
+#include <pthread.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -93,7 +94,7 @@ static inline int val_seg(int val)
  * John Wiley & Sons, pps 98-111 and 472-476.
  */
 
-static unsigned char s16_to_alaw(int pcm_val)
+static unsigned char s16_to_alaw_calc(int pcm_val)
 {
 	int		mask;
 	int		seg;
@@ -118,25 +119,158 @@ static unsigned char s16_to_alaw(int pcm_val)
 	return aval ^ mask;
 }
 
+/*
+ * The encoder ignores the low four bits of the sample magnitude, so an
+ * 11-bit magnitude index plus the sign covers the whole 16-bit range.
+ * The table holds the code words before the sign mask is applied and
+ * is filled from s16_to_alaw_calc() on first use.
+ */
+static unsigned char alaw_enc_table[(0x8000 >> 4) + 1];
+static pthread_once_t alaw_enc_once = PTHREAD_ONCE_INIT;
+
+static void alaw_enc_table_init(void)
+{
+	unsigned int i;
+	for (i = 0; i < sizeof(alaw_enc_table); i++) {
+		int val = i << 4;
+		if (val > 0x7fff)
+			val = 0x7fff;
+		alaw_enc_table[i] = s16_to_alaw_calc(val) ^ 0xD5;
+	}
+}
+
+static inline unsigned char s16_to_alaw(int pcm_val)
+{
+	if (pcm_val < 0)
+		return alaw_enc_table[(-pcm_val) >> 4] ^ 0x55;
+	return alaw_enc_table[pcm_val >> 4] ^ 0xD5;
+}
+
 /*
  * alaw_to_s16() - Convert an A-law value to 16-bit linear PCM
  *
+ * The conversion is precomputed for all 256 code words:
+ *
+ *	a_val ^= 0x55;
+ *	t = a_val & 0x7f;
+ *	if (t < 16)
+ *		t = (t << 4) + 8;
+ *	else {
+ *		seg = (t >> 4) & 0x07;
+ *		t = ((t & 0x0f) << 4) + 0x108;
+ *		t <<= seg -1;
+ *	}
+ *	return ((a_val & 0x80) ? t : -t);
  */
-static int alaw_to_s16(unsigned char a_val)
+static const int16_t alaw_s16_table[256] = {
+	 -5504,  -5248,  -6016,  -5760,  -4480,  -4224,  -4992,  -4736,
+	 -7552,  -7296,  -8064,  -7808,  -6528,  -6272,  -7040,  -6784,
+	 -2752,  -2624,  -3008,  -2880,  -2240,  -2112,  -2496,  -2368,
+	 -3776,  -3648,  -4032,  -3904,  -3264,  -3136,  -3520,  -3392,
+	-22016, -20992, -24064, -23040, -17920, -16896, -19968, -18944,
+	-30208, -29184, -32256, -31232, -26112, -25088, -28160, -27136,
+	-11008, -10496, -12032, -11520,  -8960,  -8448,  -9984,  -9472,
+	-15104, -14592, -16128, -15616, -13056, -12544, -14080, -13568,
+	  -344,   -328,   -376,   -360,   -280,   -264,   -312,   -296,
+	  -472,   -456,   -504,   -488,   -408,   -392,   -440,   -424,
+	   -88,    -72,   -120,   -104,    -24,     -8,    -56,    -40,
+	  -216,   -200,   -248,   -232,   -152,   -136,   -184,   -168,
+	 -1376,  -1312,  -1504,  -1440,  -1120,  -1056,  -1248,  -1184,
+	 -1888,  -1824,  -2016,  -1952,  -1632,  -1568,  -1760,  -1696,
+	  -688,   -656,   -752,   -720,   -560,   -528,   -624,   -592,
+	  -944,   -912,  -1008,   -976,   -816,   -784,   -880,   -848,
+	  5504,   5248,   6016,   5760,   4480,   4224,   4992,   4736,
+	  7552,   7296,   8064,   7808,   6528,   6272,   7040,   6784,
+	  2752,   2624,   3008,   2880,   2240,   2112,   2496,   2368,
+	  3776,   3648,   4032,   3904,   3264,   3136,   3520,   3392,
+	 22016,  20992,  24064,  23040,  17920,  16896,  19968,  18944,
+	 30208,  29184,  32256,  31232,  26112,  25088,  28160,  27136,
+	 11008,  10496,  12032,  11520,   8960,   8448,   9984,   9472,
+	 15104,  14592,  16128,  15616,  13056,  12544,  14080,  13568,
+	   344,    328,    376,    360,    280,    264,    312,    296,
+	   472,    456,    504,    488,    408,    392,    440,    424,
+	    88,     72,    120,    104,     24,      8,     56,     40,
+	   216,    200,    248,    232,    152,    136,    184,    168,
+	  1376,   1312,   1504,   1440,   1120,   1056,   1248,   1184,
+	  1888,   1824,   2016,   1952,   1632,   1568,   1760,   1696,
+	   688,    656,    752,    720,    560,    528,    624,    592,
+	   944,    912,   1008,    976,    816,    784,    880,    848,
+};
+
+static inline int alaw_to_s16(unsigned char a_val)
 {
-	int		t;
-	int		seg;
+	return alaw_s16_table[a_val];
+}
 
-	a_val ^= 0x55;
-	t = a_val & 0x7f;
-	if (t < 16)
-		t = (t << 4) + 8;
-	else {
-		seg = (t >> 4) & 0x07;
-		t = ((t & 0x0f) << 4) + 0x108;
-		t <<= seg -1;
+/*
+ * Native S16 kernels: straight table lookups, one pass over the whole
+ * buffer when both sides are interleaved, one strided pass per channel
+ * otherwise.
+ */
+static void alaw_decode_s16(const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+	if (snd_pcm_areas_interleaved(dst_areas, channels, 16) &&
+	    snd_pcm_areas_interleaved(src_areas, channels, 8)) {
+		const unsigned char *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+		int16_t *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		snd_pcm_uframes_t i, samples = frames * channels;
+		for (i = 0; i < samples; i++)
+			dst[i] = alaw_s16_table[src[i]];
+		return;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		const unsigned char *src;
+		char *dst;
+		int src_step, dst_step;
+		snd_pcm_uframes_t frames1 = frames;
+		src = snd_pcm_channel_area_addr(&src_areas[channel], src_offset);
+		dst = snd_pcm_channel_area_addr(&dst_areas[channel], dst_offset);
+		src_step = snd_pcm_channel_area_step(&src_areas[channel]);
+		dst_step = snd_pcm_channel_area_step(&dst_areas[channel]);
+		while (frames1-- > 0) {
+			*(int16_t *)dst = alaw_s16_table[*src];
+			src += src_step;
+			dst += dst_step;
+		}
+	}
+}
+
+static void alaw_encode_s16(const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+	if (snd_pcm_areas_interleaved(dst_areas, channels, 8) &&
+	    snd_pcm_areas_interleaved(src_areas, channels, 16)) {
+		const int16_t *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+		unsigned char *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		snd_pcm_uframes_t i, samples = frames * channels;
+		for (i = 0; i < samples; i++)
+			dst[i] = s16_to_alaw(src[i]);
+		return;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		const char *src;
+		unsigned char *dst;
+		int src_step, dst_step;
+		snd_pcm_uframes_t frames1 = frames;
+		src = snd_pcm_channel_area_addr(&src_areas[channel], src_offset);
+		dst = snd_pcm_channel_area_addr(&dst_areas[channel], dst_offset);
+		src_step = snd_pcm_channel_area_step(&src_areas[channel]);
+		dst_step = snd_pcm_channel_area_step(&dst_areas[channel]);
+		while (frames1-- > 0) {
+			*dst = s16_to_alaw(*(const int16_t *)src);
+			src += src_step;
+			dst += dst_step;
+		}
 	}
-	return ((a_val & 0x80) ? t : -t);
 }
 
 #ifndef DOC_HIDDEN
@@ -153,6 +287,11 @@ void snd_pcm_alaw_decode(const snd_pcm_channel_area_t *dst_areas,
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
 	unsigned int channel;
+	if (putidx == SND_PCM_LINEAR_S16_INDEX) {
+		alaw_decode_s16(dst_areas, dst_offset, src_areas, src_offset,
+				channels, frames);
+		return;
+	}
 	for (channel = 0; channel < channels; ++channel) {
 		const unsigned char *src;
 		char *dst;
@@ -191,6 +330,12 @@ void snd_pcm_alaw_encode(const snd_pcm_channel_area_t *dst_areas,
 	void *get = get16_labels[getidx];
 	unsigned int channel;
 	int16_t sample = 0;
+	pthread_once(&alaw_enc_once, alaw_enc_table_init);
+	if (getidx == SND_PCM_LINEAR_S16_INDEX) {
+		alaw_encode_s16(dst_areas, dst_offset, src_areas, src_offset,
+				channels, frames);
+		return;
+	}
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		char *dst;
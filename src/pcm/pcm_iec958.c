@@ -62,30 +62,56 @@ struct snd_pcm_iec958 {
 	unsigned char status[24];
 	unsigned int byteswap;
 	unsigned char preamble[3];	/* B/M/W or Z/X/Y */
+	u_int32_t subframe_bits[2][192];	/* status, its parity and preamble */
 };
 
 enum { PREAMBLE_Z, PREAMBLE_X, PREAMBLE_Y };
 
 #endif /* DOC_HIDDEN */
 
+#define P2(n) n, n ^ 1, n ^ 1, n
+#define P4(n) P2(n), P2(n ^ 1), P2(n ^ 1), P2(n)
+#define P6(n) P4(n), P4(n ^ 1), P4(n ^ 1), P4(n)
+
+static const unsigned char iec958_parity_table[256] = {
+	P6(0), P6(1), P6(1), P6(0)
+};
+
+#undef P2
+#undef P4
+#undef P6
+
 /*
  * Determine parity for time slots 4 upto 30
  * to be sure that bit 4 upt 31 will carry
  * an even number of ones and zeros.
  */
-static unsigned int iec958_parity(unsigned int data)
+static inline unsigned int iec958_parity(u_int32_t data)
 {
-	unsigned int parity;
-	int bit;
-
-	data >>= 4;     /* start from bit 4 */
-	parity = 0;
-	for (bit = 4; bit <= 30; bit++) {
-		if (data & 1)
-			parity++;
-		data >>= 1;
+	data &= 0x7ffffff0;
+	data ^= data >> 16;
+	data ^= data >> 8;
+	return iec958_parity_table[data & 0xff];
+}
+
+/*
+ * Precompute the data independent part of all subframes of a block:
+ * channel status bit with its parity contribution and the preamble,
+ * for the first (Z/X) and the other (Y) sub frames.
+ */
+static void iec958_init_subframe_bits(snd_pcm_iec958_t *iec)
+{
+	unsigned int counter;
+
+	for (counter = 0; counter < 192; counter++) {
+		u_int32_t bits = 0;
+		if (iec->status[counter >> 3] & (1 << (counter & 7)))
+			bits |= 0xc0000000;
+		iec->subframe_bits[0][counter] = bits |
+			iec->preamble[counter ? PREAMBLE_X : PREAMBLE_Z];
+		iec->subframe_bits[1][counter] = bits |
+			iec->preamble[PREAMBLE_Y];
 	}
-	return (parity & 1);
 }
 
 /*
@@ -101,29 +127,15 @@ static unsigned int iec958_parity(unsigned int data)
  *     31   = parity
  */
 
-static inline u_int32_t iec958_subframe(snd_pcm_iec958_t *iec, u_int32_t data, int channel)
+static inline u_int32_t iec958_subframe(snd_pcm_iec958_t *iec, u_int32_t data,
+					const u_int32_t *bits, unsigned int counter)
 {
-	unsigned int byte = iec->counter >> 3;
-	unsigned int mask = 1 << (iec->counter - (byte << 3));
-
 	/* bit 4-27 */
 	data >>= 4;
 	data &= ~0xf;
 
-	/* set IEC status bits (up to 192 bits) */
-	if (iec->status[byte] & mask)
-		data |= 0x40000000;
-
-	if (iec958_parity(data))	/* parity bit 4-30 */
-		data |= 0x80000000;
-
-	/* Preamble */
-	if (channel)
-		data |= iec->preamble[PREAMBLE_Y];	/* odd sub frame, 'Y' */
-	else if (! iec->counter)
-		data |= iec->preamble[PREAMBLE_Z];	/* Block start, 'Z' */
-	else
-		data |= iec->preamble[PREAMBLE_X];	/* even sub frame, 'X' */
+	/* status, preamble and parity bit 4-30 */
+	data = (data | bits[counter]) ^ (iec958_parity(data) << 31);
 
 	if (iec->byteswap)
 		data = bswap_32(data);
@@ -165,6 +177,15 @@ static void snd_pcm_iec958_decode(snd_pcm_iec958_t *iec,
 		src_step = snd_pcm_channel_area_step(src_area) / sizeof(u_int32_t);
 		dst_step = snd_pcm_channel_area_step(dst_area);
 		frames1 = frames;
+		if (iec->getput_idx == SND_PCM_LINEAR_S32_INDEX) {
+			/* native S32: no conversion labels */
+			while (frames1-- > 0) {
+				*(int32_t *)dst = iec958_to_s32(iec, *src);
+				src += src_step;
+				dst += dst_step;
+			}
+			continue;
+		}
 		while (frames1-- > 0) {
 			int32_t sample = iec958_to_s32(iec, *src);
 			goto *put;
@@ -191,7 +212,7 @@ static void snd_pcm_iec958_encode(snd_pcm_iec958_t *iec,
 	void *get = get32_labels[iec->getput_idx];
 	unsigned int channel;
 	int32_t sample = 0;
-	int counter = iec->counter;
+	unsigned int counter = iec->counter;
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		u_int32_t *dst;
@@ -199,25 +220,38 @@ static void snd_pcm_iec958_encode(snd_pcm_iec958_t *iec,
 		snd_pcm_uframes_t frames1;
 		const snd_pcm_channel_area_t *src_area = &src_areas[channel];
 		const snd_pcm_channel_area_t *dst_area = &dst_areas[channel];
+		const u_int32_t *bits = iec->subframe_bits[channel ? 1 : 0];
 		src = snd_pcm_channel_area_addr(src_area, src_offset);
 		dst = snd_pcm_channel_area_addr(dst_area, dst_offset);
 		src_step = snd_pcm_channel_area_step(src_area);
 		dst_step = snd_pcm_channel_area_step(dst_area) / sizeof(u_int32_t);
 		frames1 = frames;
 		iec->counter = counter;
+		if (iec->getput_idx == SND_PCM_LINEAR_S32_INDEX) {
+			/* native S32: no conversion labels */
+			while (frames1-- > 0) {
+				*dst = iec958_subframe(iec, *(const u_int32_t *)src,
+						       bits, iec->counter);
+				src += src_step;
+				dst += dst_step;
+				if (++iec->counter == 192)
+					iec->counter = 0;
+			}
+			continue;
+		}
 		while (frames1-- > 0) {
 			goto *get;
 #define GET32_END after
 #include "plugin_ops.h"
 #undef GET32_END
 		after:
-			sample = iec958_subframe(iec, sample, channel);
+			sample = iec958_subframe(iec, sample, bits, iec->counter);
 			// fprintf(stderr, "%d:%08x\n", frames1, sample);
 			*dst = sample;
 			src += src_step;
 			dst += dst_step;
-			iec->counter++;
-			iec->counter %= 192;
+			if (++iec->counter == 192)
+				iec->counter = 0;
 		}
 	}
 }
@@ -485,6 +519,7 @@ int snd_pcm_iec958_open(snd_pcm_t **pcmp, const char *name, snd_pcm_format_t sfo
 		memcpy(iec->status, default_status_bits, sizeof(default_status_bits));
 
 	memcpy(iec->preamble, preamble_vals, 3);
+	iec958_init_subframe_bits(iec);
 
 	err = snd_pcm_new(&pcm, SND_PCM_TYPE_IEC958, name, slave->stream, slave->mode);
 	if (err < 0) {
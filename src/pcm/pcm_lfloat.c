@@ -93,6 +93,104 @@ int snd_pcm_lfloat_put_s32_index(snd_pcm_format_t format)
 
 #ifndef DOC_HIDDEN
 
+/*
+ * Host endian FLOAT <-> S16 / S24 / S32 kernels. They compute exactly
+ * what the get32/put32 and put32float/get32float label pairs do, but
+ * as plain loops the compiler can vectorize. Steps are in samples.
+ */
+#define DEFINE_LFLOAT_KERNELS(itype, suffix, to_s32, from_s32)		\
+static inline float_t lfloat_##suffix##_get(itype v)			\
+{									\
+	return (float_t)(int32_t)(to_s32) / (float_t)0x80000000UL;	\
+}									\
+static inline itype lfloat_##suffix##_put(float_t f)			\
+{									\
+	int32_t sample;							\
+	if (f >= 1.0)							\
+		sample = 0x7fffffff;					\
+	else if (f <= -1.0)						\
+		sample = 0x80000000;					\
+	else								\
+		sample = (int32_t)(f * (float_t)0x80000000UL);		\
+	return (from_s32);						\
+}									\
+static void lfloat_##suffix##_to_float(void *dstp, int dst_step,	\
+				       const void *srcp, int src_step,	\
+				       snd_pcm_uframes_t samples)	\
+{									\
+	float_t *dst = dstp;						\
+	const itype *src = srcp;					\
+	snd_pcm_uframes_t i;						\
+	if (src_step == 1 && dst_step == 1) {				\
+		for (i = 0; i < samples; i++)				\
+			dst[i] = lfloat_##suffix##_get(src[i]);		\
+		return;							\
+	}								\
+	for (i = 0; i < samples; i++, src += src_step, dst += dst_step) \
+		*dst = lfloat_##suffix##_get(*src);			\
+}									\
+static void lfloat_float_to_##suffix(void *dstp, int dst_step,		\
+				     const void *srcp, int src_step,	\
+				     snd_pcm_uframes_t samples)		\
+{									\
+	itype *dst = dstp;						\
+	const float_t *src = srcp;					\
+	snd_pcm_uframes_t i;						\
+	if (src_step == 1 && dst_step == 1) {				\
+		for (i = 0; i < samples; i++)				\
+			dst[i] = lfloat_##suffix##_put(src[i]);		\
+		return;							\
+	}								\
+	for (i = 0; i < samples; i++, src += src_step, dst += dst_step) \
+		*dst = lfloat_##suffix##_put(*src);			\
+}
+
+DEFINE_LFLOAT_KERNELS(int16_t, s16, (u_int32_t)(u_int16_t)v << 16, sample >> 16)
+DEFINE_LFLOAT_KERNELS(int32_t, s24, (u_int32_t)v << 8, sx24(sample >> 8))
+DEFINE_LFLOAT_KERNELS(int32_t, s32, v, sample)
+
+typedef void (*lfloat_kernel_t)(void *dst, int dst_step,
+				const void *src, int src_step,
+				snd_pcm_uframes_t samples);
+
+/*
+ * Run a kernel over all channels: one pass over the whole buffer when
+ * both sides are interleaved in the same channel order, otherwise one
+ * strided pass per channel. Returns 0 when no kernel applies.
+ */
+static int lfloat_convert_fast(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
+			       const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
+			       unsigned int channels, snd_pcm_uframes_t frames,
+			       lfloat_kernel_t kernel, int dst_width, int src_width)
+{
+	unsigned int channel;
+
+	if (!kernel)
+		return 0;
+	for (channel = 0; channel < channels; ++channel) {
+		if (dst_areas[channel].first % dst_width ||
+		    dst_areas[channel].step % dst_width ||
+		    src_areas[channel].first % src_width ||
+		    src_areas[channel].step % src_width)
+			return 0;
+	}
+	if (snd_pcm_areas_interleaved(dst_areas, channels, dst_width) &&
+	    snd_pcm_areas_interleaved(src_areas, channels, src_width)) {
+		kernel(snd_pcm_channel_area_addr(dst_areas, dst_offset), 1,
+		       snd_pcm_channel_area_addr(src_areas, src_offset), 1,
+		       frames * channels);
+		return 1;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		kernel(snd_pcm_channel_area_addr(&dst_areas[channel], dst_offset),
+		       dst_areas[channel].step / dst_width,
+		       snd_pcm_channel_area_addr(&src_areas[channel], src_offset),
+		       src_areas[channel].step / src_width,
+		       frames);
+	}
+	return 1;
+}
+
 void snd_pcm_lfloat_convert_integer_float(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
 					  const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 					  unsigned int channels, snd_pcm_uframes_t frames,
@@ -106,6 +204,26 @@ void snd_pcm_lfloat_convert_integer_float(const snd_pcm_channel_area_t *dst_area
 	void *get32 = get32_labels[get32idx];
 	void *put32float = put32float_labels[put32floatidx];
 	unsigned int channel;
+	lfloat_kernel_t kernel = NULL;
+	int src_width = 32;
+
+	if (put32floatidx == 0) {
+		switch (get32idx) {
+		case SND_PCM_LINEAR_S16_INDEX:
+			kernel = lfloat_s16_to_float;
+			src_width = 16;
+			break;
+		case SND_PCM_LINEAR_S24_INDEX:
+			kernel = lfloat_s24_to_float;
+			break;
+		case SND_PCM_LINEAR_S32_INDEX:
+			kernel = lfloat_s32_to_float;
+			break;
+		}
+	}
+	if (lfloat_convert_fast(dst_areas, dst_offset, src_areas, src_offset,
+				channels, frames, kernel, 32, src_width))
+		return;
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		char *dst;
@@ -151,6 +269,26 @@ void snd_pcm_lfloat_convert_float_integer(const snd_pcm_channel_area_t *dst_area
 	void *put32 = put32_labels[put32idx];
 	void *get32float = get32float_labels[get32floatidx];
 	unsigned int channel;
+	lfloat_kernel_t kernel = NULL;
+	int dst_width = 32;
+
+	if (get32floatidx == 0) {
+		switch (put32idx) {
+		case SND_PCM_LINEAR_S16_INDEX:
+			kernel = lfloat_float_to_s16;
+			dst_width = 16;
+			break;
+		case SND_PCM_LINEAR_S24_INDEX:
+			kernel = lfloat_float_to_s24;
+			break;
+		case SND_PCM_LINEAR_S32_INDEX:
+			kernel = lfloat_float_to_s32;
+			break;
+		}
+	}
+	if (lfloat_convert_fast(dst_areas, dst_offset, src_areas, src_offset,
+				channels, frames, kernel, dst_width, 32))
+		return;
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		char *dst;
@@ -250,6 +250,8 @@ struct _snd_pcm {
 	snd1_pcm_areas_from_buf
 #define snd_pcm_areas_from_bufs \
 	snd1_pcm_areas_from_bufs
+#define snd_pcm_areas_interleaved \
+	snd1_pcm_areas_interleaved
 #define snd_pcm_open_named_slave \
 	snd1_pcm_open_named_slave
 #define snd_pcm_conf_generic_id \
@@ -347,6 +349,8 @@ int snd_pcm_free(snd_pcm_t *pcm);
 
 void snd_pcm_areas_from_buf(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void *buf);
 void snd_pcm_areas_from_bufs(snd_pcm_t *pcm, snd_pcm_channel_area_t *areas, void **bufs);
+int snd_pcm_areas_interleaved(const snd_pcm_channel_area_t *areas,
+			      unsigned int channels, int width);
 
 int snd_pcm_async(snd_pcm_t *pcm, int sig, pid_t pid);
 int snd_pcm_mmap(snd_pcm_t *pcm);
@@ -537,6 +537,32 @@ u_int8_t snd_pcm_format_silence(snd_pcm_format_t format)
 	return (u_int8_t)snd_pcm_format_silence_64(format);
 }
 
+/*
+ * Fill a buffer with a repeating byte pattern using aligned 64 bit stores.
+ * pat holds the pattern twice (2 * period bytes), period is 8 or 24.
+ */
+static inline void fill_pattern(u_int8_t *dst, size_t bytes,
+				const u_int8_t *pat, unsigned int period)
+{
+	u_int64_t w[3];
+	unsigned int head = (8 - ((unsigned long)dst & 7)) & 7;
+	unsigned int i;
+
+	if (head > bytes)
+		head = bytes;
+	memcpy(dst, pat, head);
+	dst += head;
+	bytes -= head;
+	memcpy(w, pat + head, period);
+	while (bytes >= period) {
+		for (i = 0; i < period / 8; i++)
+			((u_int64_t *)dst)[i] = w[i];
+		dst += period;
+		bytes -= period;
+	}
+	memcpy(dst, w, bytes);
+}
+
 /**
  * \brief Silence a PCM samples buffer
  * \param format Sample format
@@ -546,74 +572,54 @@ u_int8_t snd_pcm_format_silence(snd_pcm_format_t format)
  */
 int snd_pcm_format_set_silence(snd_pcm_format_t format, void *data, unsigned int samples)
 {
+	u_int64_t silence;
+	int width;
+
 	if (samples == 0)
 		return 0;
-	switch (snd_pcm_format_physical_width(format)) {
-	case 4: {
-		u_int8_t silence = snd_pcm_format_silence_64(format);
-		unsigned int samples1;
+	width = snd_pcm_format_physical_width(format);
+	silence = snd_pcm_format_silence_64(format);
+	switch (width) {
+	case 4:
 		if (samples % 2 != 0)
 			return -EINVAL;
-		samples1 = samples / 2;
-		memset(data, silence, samples1);
-		break;
-	}
-	case 8: {
-		u_int8_t silence = snd_pcm_format_silence_64(format);
-		memset(data, silence, samples);
+		samples /= 2;
+		/* Fall through */
+	case 8:
+		memset(data, (u_int8_t)silence, samples);
 		break;
-	}
-	case 16: {
-		u_int16_t silence = snd_pcm_format_silence_64(format);
-		u_int16_t *pdata = (u_int16_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 2);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
+	case 16:
+	case 32:
+	case 64: {
+		u_int64_t pat[2];
+		if (! silence) {
+			memset(data, 0, samples * (width / 8));
+			break;
 		}
+		pat[0] = pat[1] = silence;
+		fill_pattern(data, samples * (width / 8), (u_int8_t *)pat, 8);
 		break;
 	}
 	case 24: {
-		u_int32_t silence = snd_pcm_format_silence_64(format);
-		u_int8_t *pdata = (u_int8_t *)data;
-		if (! silence)
+		u_int8_t pat[48];
+		unsigned int i;
+		if (! silence) {
 			memset(data, 0, samples * 3);
-		else {
-			while (samples-- > 0) {
+			break;
+		}
+		/* 8 samples make a whole number of 64 bit words */
+		for (i = 0; i < sizeof(pat); i += 3) {
 #ifdef SNDRV_LITTLE_ENDIAN
-				*pdata++ = silence >> 0;
-				*pdata++ = silence >> 8;
-				*pdata++ = silence >> 16;
+			pat[i + 0] = silence >> 0;
+			pat[i + 1] = silence >> 8;
+			pat[i + 2] = silence >> 16;
 #else
-				*pdata++ = silence >> 16;
-				*pdata++ = silence >> 8;
-				*pdata++ = silence >> 0;
+			pat[i + 0] = silence >> 16;
+			pat[i + 1] = silence >> 8;
+			pat[i + 2] = silence >> 0;
 #endif
-			}
-		}
-		break;
-	}
-	case 32: {
-		u_int32_t silence = snd_pcm_format_silence_64(format);
-		u_int32_t *pdata = (u_int32_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 4);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
-		}
-		break;
-	}
-	case 64: {
-		u_int64_t silence = snd_pcm_format_silence_64(format);
-		u_int64_t *pdata = (u_int64_t *)data;
-		if (! silence)
-			memset(data, 0, samples * 8);
-		else {
-			while (samples-- > 0)
-				*pdata++ = silence;
 		}
+		fill_pattern(data, samples * 3, pat, 24);
 		break;
 	}
 	default:
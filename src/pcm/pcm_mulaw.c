@@ -27,6 +27,7 @@
  */
   
 #include <byteswap.h>
+#include <pthread.h>
 #include "pcm_local.h"
 #include "pcm_plugin.h"
 
@@ -103,7 +104,7 @@ static inline int val_seg(int val)
  * John Wiley & Sons, pps 98-111 and 472-476.
  */
 
-static unsigned char s16_to_ulaw(int pcm_val)	/* 2's complement (16-bit range) */
+static unsigned char s16_to_ulaw_calc(int pcm_val)	/* 2's complement (16-bit range) */
 {
 	int mask;
 	int seg;
@@ -130,6 +131,34 @@ static unsigned char s16_to_ulaw(int pcm_val)	/* 2's complement (16-bit range) *
 	return uval ^ mask;
 }
 
+/*
+ * The encoder output depends only on the magnitude of the input sample
+ * shifted right by two bits (the 0x84 bias is a multiple of four), so a
+ * 13-bit magnitude index plus the sign covers the whole 16-bit range.
+ * The table holds the uncomplemented code words and is filled from
+ * s16_to_ulaw_calc() on first use.
+ */
+static unsigned char ulaw_enc_table[(0x8000 >> 2) + 1];
+static pthread_once_t ulaw_enc_once = PTHREAD_ONCE_INIT;
+
+static void ulaw_enc_table_init(void)
+{
+	unsigned int i;
+	for (i = 0; i < sizeof(ulaw_enc_table); i++) {
+		int val = i << 2;
+		if (val > 0x7fff)
+			val = 0x7fff;
+		ulaw_enc_table[i] = s16_to_ulaw_calc(val) ^ 0xff;
+	}
+}
+
+static inline unsigned char s16_to_ulaw(int pcm_val)
+{
+	if (pcm_val < 0)
+		return ulaw_enc_table[(-pcm_val) >> 2] ^ 0x7f;
+	return ulaw_enc_table[pcm_val >> 2] ^ 0xff;
+}
+
 /*
  * ulaw_to_s16() - Convert a u-law value to 16-bit linear PCM
  *
@@ -138,22 +167,123 @@ static unsigned char s16_to_ulaw(int pcm_val)	/* 2's complement (16-bit range) *
  *
  * Note that this function expects to be passed the complement of the
  * original code word. This is in keeping with ISDN conventions.
+ *
+ * The conversion is precomputed for all 256 code words:
+ *
+ *	u_val = ~u_val;
+ *	t = ((u_val & 0x0f) << 3) + 0x84;
+ *	t <<= (u_val & 0x70) >> 4;
+ *	return ((u_val & 0x80) ? (0x84 - t) : (t - 0x84));
  */
-static int ulaw_to_s16(unsigned char u_val)
-{
-	int t;
+static const int16_t ulaw_s16_table[256] = {
+	-32124, -31100, -30076, -29052, -28028, -27004, -25980, -24956,
+	-23932, -22908, -21884, -20860, -19836, -18812, -17788, -16764,
+	-15996, -15484, -14972, -14460, -13948, -13436, -12924, -12412,
+	-11900, -11388, -10876, -10364,  -9852,  -9340,  -8828,  -8316,
+	 -7932,  -7676,  -7420,  -7164,  -6908,  -6652,  -6396,  -6140,
+	 -5884,  -5628,  -5372,  -5116,  -4860,  -4604,  -4348,  -4092,
+	 -3900,  -3772,  -3644,  -3516,  -3388,  -3260,  -3132,  -3004,
+	 -2876,  -2748,  -2620,  -2492,  -2364,  -2236,  -2108,  -1980,
+	 -1884,  -1820,  -1756,  -1692,  -1628,  -1564,  -1500,  -1436,
+	 -1372,  -1308,  -1244,  -1180,  -1116,  -1052,   -988,   -924,
+	  -876,   -844,   -812,   -780,   -748,   -716,   -684,   -652,
+	  -620,   -588,   -556,   -524,   -492,   -460,   -428,   -396,
+	  -372,   -356,   -340,   -324,   -308,   -292,   -276,   -260,
+	  -244,   -228,   -212,   -196,   -180,   -164,   -148,   -132,
+	  -120,   -112,   -104,    -96,    -88,    -80,    -72,    -64,
+	   -56,    -48,    -40,    -32,    -24,    -16,     -8,      0,
+	 32124,  31100,  30076,  29052,  28028,  27004,  25980,  24956,
+	 23932,  22908,  21884,  20860,  19836,  18812,  17788,  16764,
+	 15996,  15484,  14972,  14460,  13948,  13436,  12924,  12412,
+	 11900,  11388,  10876,  10364,   9852,   9340,   8828,   8316,
+	  7932,   7676,   7420,   7164,   6908,   6652,   6396,   6140,
+	  5884,   5628,   5372,   5116,   4860,   4604,   4348,   4092,
+	  3900,   3772,   3644,   3516,   3388,   3260,   3132,   3004,
+	  2876,   2748,   2620,   2492,   2364,   2236,   2108,   1980,
+	  1884,   1820,   1756,   1692,   1628,   1564,   1500,   1436,
+	  1372,   1308,   1244,   1180,   1116,   1052,    988,    924,
+	   876,    844,    812,    780,    748,    716,    684,    652,
+	   620,    588,    556,    524,    492,    460,    428,    396,
+	   372,    356,    340,    324,    308,    292,    276,    260,
+	   244,    228,    212,    196,    180,    164,    148,    132,
+	   120,    112,    104,     96,     88,     80,     72,     64,
+	    56,     48,     40,     32,     24,     16,      8,      0,
+};
 
-	/* Complement to obtain normal u-law value. */
-	u_val = ~u_val;
+static inline int ulaw_to_s16(unsigned char u_val)
+{
+	return ulaw_s16_table[u_val];
+}
 
-	/*
-	 * Extract and bias the quantization bits. Then
-	 * shift up by the segment number and subtract out the bias.
-	 */
-	t = ((u_val & 0x0f) << 3) + 0x84;
-	t <<= (u_val & 0x70) >> 4;
+/*
+ * Native S16 kernels: straight table lookups, one pass over the whole
+ * buffer when both sides are interleaved, one strided pass per channel
+ * otherwise.
+ */
+static void ulaw_decode_s16(const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+	if (snd_pcm_areas_interleaved(dst_areas, channels, 16) &&
+	    snd_pcm_areas_interleaved(src_areas, channels, 8)) {
+		const unsigned char *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+		int16_t *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		snd_pcm_uframes_t i, samples = frames * channels;
+		for (i = 0; i < samples; i++)
+			dst[i] = ulaw_s16_table[src[i]];
+		return;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		const unsigned char *src;
+		char *dst;
+		int src_step, dst_step;
+		snd_pcm_uframes_t frames1 = frames;
+		src = snd_pcm_channel_area_addr(&src_areas[channel], src_offset);
+		dst = snd_pcm_channel_area_addr(&dst_areas[channel], dst_offset);
+		src_step = snd_pcm_channel_area_step(&src_areas[channel]);
+		dst_step = snd_pcm_channel_area_step(&dst_areas[channel]);
+		while (frames1-- > 0) {
+			*(int16_t *)dst = ulaw_s16_table[*src];
+			src += src_step;
+			dst += dst_step;
+		}
+	}
+}
 
-	return ((u_val & 0x80) ? (0x84 - t) : (t - 0x84));
+static void ulaw_encode_s16(const snd_pcm_channel_area_t *dst_areas,
+			    snd_pcm_uframes_t dst_offset,
+			    const snd_pcm_channel_area_t *src_areas,
+			    snd_pcm_uframes_t src_offset,
+			    unsigned int channels, snd_pcm_uframes_t frames)
+{
+	unsigned int channel;
+	if (snd_pcm_areas_interleaved(dst_areas, channels, 8) &&
+	    snd_pcm_areas_interleaved(src_areas, channels, 16)) {
+		const int16_t *src = snd_pcm_channel_area_addr(src_areas, src_offset);
+		unsigned char *dst = snd_pcm_channel_area_addr(dst_areas, dst_offset);
+		snd_pcm_uframes_t i, samples = frames * channels;
+		for (i = 0; i < samples; i++)
+			dst[i] = s16_to_ulaw(src[i]);
+		return;
+	}
+	for (channel = 0; channel < channels; ++channel) {
+		const char *src;
+		unsigned char *dst;
+		int src_step, dst_step;
+		snd_pcm_uframes_t frames1 = frames;
+		src = snd_pcm_channel_area_addr(&src_areas[channel], src_offset);
+		dst = snd_pcm_channel_area_addr(&dst_areas[channel], dst_offset);
+		src_step = snd_pcm_channel_area_step(&src_areas[channel]);
+		dst_step = snd_pcm_channel_area_step(&dst_areas[channel]);
+		while (frames1-- > 0) {
+			*dst = s16_to_ulaw(*(const int16_t *)src);
+			src += src_step;
+			dst += dst_step;
+		}
+	}
 }
 
 #ifndef DOC_HIDDEN
@@ -170,6 +300,11 @@ void snd_pcm_mulaw_decode(const snd_pcm_channel_area_t *dst_areas,
 #undef PUT16_LABELS
 	void *put = put16_labels[putidx];
 	unsigned int channel;
+	if (putidx == SND_PCM_LINEAR_S16_INDEX) {
+		ulaw_decode_s16(dst_areas, dst_offset, src_areas, src_offset,
+				channels, frames);
+		return;
+	}
 	for (channel = 0; channel < channels; ++channel) {
 		const unsigned char *src;
 		char *dst;
@@ -208,6 +343,12 @@ void snd_pcm_mulaw_encode(const snd_pcm_channel_area_t *dst_areas,
 	void *get = get16_labels[getidx];
 	unsigned int channel;
 	int16_t sample = 0;
+	pthread_once(&ulaw_enc_once, ulaw_enc_table_init);
+	if (getidx == SND_PCM_LINEAR_S16_INDEX) {
+		ulaw_encode_s16(dst_areas, dst_offset, src_areas, src_offset,
+				channels, frames);
+		return;
+	}
 	for (channel = 0; channel < channels; ++channel) {
 		const char *src;
 		char *dst;
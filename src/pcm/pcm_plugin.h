@@ -100,6 +100,11 @@ int snd_pcm_linear_get32_index(snd_pcm_format_t src_format, snd_pcm_format_t dst
 int snd_pcm_linear_put32_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format);
 int snd_pcm_linear_convert_index(snd_pcm_format_t src_format, snd_pcm_format_t dst_format);
 
+/* get/put index of host endian signed 16, 24 (in 32 bit) and 32 bit samples */
+#define SND_PCM_LINEAR_S16_INDEX	4
+#define SND_PCM_LINEAR_S24_INDEX	8
+#define SND_PCM_LINEAR_S32_INDEX	12
+
 void snd_pcm_linear_convert(const snd_pcm_channel_area_t *dst_areas, snd_pcm_uframes_t dst_offset,
 			    const snd_pcm_channel_area_t *src_areas, snd_pcm_uframes_t src_offset,
 			    unsigned int channels, snd_pcm_uframes_t frames,
@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "test.h"
+#include <alsa/control_external.h>
+
+/*
+ * A fake card on top of control_ext: element 0 is a plain volume,
+ * element 1 a volatile meter.  The callbacks count the driver accesses
+ * and the events are queued by post_event().
+ */
+#define ELEMS 2
+#define QUEUE 16
+
+static const char *const elem_names[ELEMS] = {
+	"Master Playback Volume",
+	"Peak Meter",
+};
+static long elem_values[ELEMS][2];
+static int info_count, read_count, write_count;
+
+static struct {
+	snd_ctl_elem_id_t *id[QUEUE];
+	unsigned int mask[QUEUE];
+	unsigned int head, tail;
+} events;
+
+static int fake_elem_count(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED)
+{
+	return ELEMS;
+}
+
+static int fake_elem_list(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			  unsigned int offset, snd_ctl_elem_id_t *id)
+{
+	if (offset >= ELEMS)
+		return -EINVAL;
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, elem_names[offset]);
+	return 0;
+}
+
+static snd_ctl_ext_key_t fake_find_elem(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+					const snd_ctl_elem_id_t *id)
+{
+	snd_ctl_ext_key_t key;
+
+	for (key = 0; key < ELEMS; key++)
+		if (!strcmp(snd_ctl_elem_id_get_name(id), elem_names[key]))
+			return key;
+	return SND_CTL_EXT_KEY_NOT_FOUND;
+}
+
+static int fake_get_attribute(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			      snd_ctl_ext_key_t key, int *type,
+			      unsigned int *acc, unsigned int *count)
+{
+	*type = SND_CTL_ELEM_TYPE_INTEGER;
+	*acc = SND_CTL_EXT_ACCESS_READWRITE;
+	if (key == 1)
+		*acc |= SND_CTL_EXT_ACCESS_VOLATILE;
+	*count = 2;
+	return 0;
+}
+
+static int fake_get_integer_info(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				 snd_ctl_ext_key_t key ATTRIBUTE_UNUSED,
+				 long *imin, long *imax, long *istep)
+{
+	info_count++;
+	*imin = 0;
+	*imax = 100;
+	*istep = 0;
+	return 0;
+}
+
+static int fake_read_integer(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			     snd_ctl_ext_key_t key, long *value)
+{
+	read_count++;
+	value[0] = elem_values[key][0];
+	value[1] = elem_values[key][1];
+	return 0;
+}
+
+static int fake_write_integer(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			      snd_ctl_ext_key_t key, long *value)
+{
+	int changed;
+
+	write_count++;
+	changed = elem_values[key][0] != value[0] ||
+		  elem_values[key][1] != value[1];
+	elem_values[key][0] = value[0];
+	elem_values[key][1] = value[1];
+	return changed;
+}
+
+static void fake_subscribe_events(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+				  int subscribe ATTRIBUTE_UNUSED)
+{
+}
+
+static int fake_read_event(snd_ctl_ext_t *ext ATTRIBUTE_UNUSED,
+			   snd_ctl_elem_id_t *id, unsigned int *event_mask)
+{
+	unsigned int i;
+
+	if (events.head == events.tail)
+		return -EAGAIN;
+	i = events.tail++ % QUEUE;
+	snd_ctl_elem_id_copy(id, events.id[i]);
+	*event_mask = events.mask[i];
+	snd_ctl_elem_id_free(events.id[i]);
+	return 1;
+}
+
+static const snd_ctl_ext_callback_t fake_callback = {
+	.elem_count = fake_elem_count,
+	.elem_list = fake_elem_list,
+	.find_elem = fake_find_elem,
+	.get_attribute = fake_get_attribute,
+	.get_integer_info = fake_get_integer_info,
+	.read_integer = fake_read_integer,
+	.write_integer = fake_write_integer,
+	.subscribe_events = fake_subscribe_events,
+	.read_event = fake_read_event,
+};
+
+static snd_ctl_ext_t fake_ext = {
+	.version = SND_CTL_EXT_VERSION,
+	.id = "Fake",
+	.driver = "Fake",
+	.name = "Fake",
+	.longname = "Fake",
+	.mixername = "Fake",
+	.poll_fd = -1,
+	.callback = &fake_callback,
+};
+
+static void post_event(unsigned int key, unsigned int mask)
+{
+	unsigned int i = events.head++ % QUEUE;
+
+	if (ALSA_CHECK(snd_ctl_elem_id_malloc(&events.id[i])) < 0)
+		return;
+	snd_ctl_elem_id_set_interface(events.id[i], SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(events.id[i], elem_names[key]);
+	events.mask[i] = mask;
+}
+
+static snd_hctl_elem_t *find_elem(snd_hctl_t *hctl, unsigned int key)
+{
+	snd_ctl_elem_id_t *id;
+
+	snd_ctl_elem_id_alloca(&id);
+	snd_ctl_elem_id_set_interface(id, SND_CTL_ELEM_IFACE_MIXER);
+	snd_ctl_elem_id_set_name(id, elem_names[key]);
+	return snd_hctl_find_elem(hctl, id);
+}
+
+/* returns the number of driver reads for reading the element twice */
+static int read_twice(snd_hctl_elem_t *elem, long expected)
+{
+	snd_ctl_elem_value_t *value;
+	int reads = read_count, i;
+
+	snd_ctl_elem_value_alloca(&value);
+	for (i = 0; i < 2; i++) {
+		ALSA_CHECK(snd_hctl_elem_read(elem, value));
+		TEST_CHECK(snd_ctl_elem_value_get_integer(value, 0) == expected);
+	}
+	return read_count - reads;
+}
+
+/* returns the number of driver infos for getting the info twice */
+static int info_twice(snd_hctl_elem_t *elem)
+{
+	snd_ctl_elem_info_t *info;
+	int infos = info_count, i;
+
+	snd_ctl_elem_info_alloca(&info);
+	for (i = 0; i < 2; i++) {
+		ALSA_CHECK(snd_hctl_elem_info(elem, info));
+		TEST_CHECK(snd_ctl_elem_info_get_max(info) == 100);
+	}
+	return info_count - infos;
+}
+
+static void test_hits(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t *elem = find_elem(hctl, 0);
+
+	elem_values[0][0] = 10;
+	ALSA_CHECK(snd_hctl_set_cache(hctl, 0));
+	TEST_CHECK(info_twice(elem) == 2);
+	TEST_CHECK(read_twice(elem, 10) == 2);
+
+	ALSA_CHECK(snd_hctl_set_cache(hctl, 1));
+	TEST_CHECK(info_twice(elem) == 1);
+	TEST_CHECK(read_twice(elem, 10) == 1);
+
+	/* a change without an event is not seen */
+	elem_values[0][0] = 20;
+	TEST_CHECK(read_twice(elem, 10) == 0);
+}
+
+static void test_events(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t *elem = find_elem(hctl, 0);
+
+	ALSA_CHECK(snd_hctl_set_cache(hctl, 1));
+	elem_values[0][0] = 30;
+	TEST_CHECK(info_twice(elem) == 1);
+	TEST_CHECK(read_twice(elem, 30) == 1);
+
+	elem_values[0][0] = 31;
+	post_event(0, SND_CTL_EVENT_MASK_VALUE);
+	TEST_CHECK(ALSA_CHECK(snd_hctl_handle_events(hctl)) == 1);
+	TEST_CHECK(info_twice(elem) == 0);
+	TEST_CHECK(read_twice(elem, 31) == 1);
+
+	elem_values[0][0] = 32;
+	post_event(0, SND_CTL_EVENT_MASK_INFO);
+	TEST_CHECK(ALSA_CHECK(snd_hctl_handle_events(hctl)) == 1);
+	TEST_CHECK(info_twice(elem) == 1);
+	TEST_CHECK(read_twice(elem, 32) == 1);
+
+	/* events of other elements keep the cache */
+	post_event(1, SND_CTL_EVENT_MASK_VALUE | SND_CTL_EVENT_MASK_INFO);
+	TEST_CHECK(ALSA_CHECK(snd_hctl_handle_events(hctl)) == 1);
+	TEST_CHECK(info_twice(elem) == 0);
+	TEST_CHECK(read_twice(elem, 32) == 0);
+}
+
+static void test_volatile(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t *elem = find_elem(hctl, 1);
+
+	ALSA_CHECK(snd_hctl_set_cache(hctl, 1));
+	elem_values[1][0] = 40;
+	TEST_CHECK(info_twice(elem) == 1);
+	TEST_CHECK(read_twice(elem, 40) == 2);
+	elem_values[1][0] = 41;
+	TEST_CHECK(read_twice(elem, 41) == 2);
+}
+
+static void test_write(snd_hctl_t *hctl)
+{
+	snd_hctl_elem_t *elem = find_elem(hctl, 0);
+	snd_ctl_elem_value_t *value;
+	int writes = write_count;
+
+	ALSA_CHECK(snd_hctl_set_cache(hctl, 1));
+	elem_values[0][0] = 50;
+	TEST_CHECK(read_twice(elem, 50) == 1);
+
+	snd_ctl_elem_value_alloca(&value);
+	snd_ctl_elem_value_set_integer(value, 0, 51);
+	snd_ctl_elem_value_set_integer(value, 1, 51);
+	ALSA_CHECK(snd_hctl_elem_write(elem, value));
+	TEST_CHECK(write_count - writes == 1);
+	TEST_CHECK(read_twice(elem, 51) == 1);
+}
+
+int main(void)
+{
+	snd_hctl_t *hctl;
+
+	if (ALSA_CHECK(snd_ctl_ext_create(&fake_ext, "fake", 0)) < 0)
+		return TEST_EXIT_CODE();
+	if (ALSA_CHECK(snd_hctl_open_ctl(&hctl, fake_ext.handle)) < 0)
+		return TEST_EXIT_CODE();
+	ALSA_CHECK(snd_hctl_nonblock(hctl, 1));
+	if (ALSA_CHECK(snd_hctl_load(hctl)) < 0)
+		return TEST_EXIT_CODE();
+	TEST_CHECK(snd_hctl_get_count(hctl) == ELEMS);
+
+	test_hits(hctl);
+	test_events(hctl);
+	test_volatile(hctl);
+	test_write(hctl);
+
+	ALSA_CHECK(snd_hctl_close(hctl));
+	return TEST_EXIT_CODE();
+}